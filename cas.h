@@ -25,7 +25,7 @@
  * Now, we know that var is set to new_var.
  */
 static inline int 
-__cas(unsigned long *target, unsigned long cmp, unsigned long updated)
+__cas(volatile unsigned long *target, unsigned long cmp, unsigned long updated)
 {
 	char z;
 	__asm__ __volatile__("lock cmpxchgl %2, %0; setz %1"
@@ -37,4 +37,41 @@ __cas(unsigned long *target, unsigned long cmp, unsigned long updated)
 	return (int)!z;
 }
 
+/* 
+ * Atomic exchange instruction.
+ * target : the memory address to perform the atomic op on.
+ * value  : the new value that will be written into target.
+ * return : the value held by target before the exchange.
+ *
+ * xchg with a memory operand is implicitly locked, so this is also a
+ * full memory barrier.
+ */
+static inline unsigned long
+__xchg(volatile unsigned long *target, unsigned long value)
+{
+	__asm__ __volatile__("xchgl %0, %1"
+			     : "+r" (value),
+			       "+m" (*target)
+			     :
+			     : "memory");
+	return value;
+}
+
+/* 
+ * Compiler barrier: prevents the compiler from moving memory accesses
+ * across it.  Stores are not reordered with stores (nor loads with
+ * loads) on x86, so this is enough to publish data before a flag.
+ */
+#define __compiler_barrier() __asm__ __volatile__("" ::: "memory")
+
+/* 
+ * Full memory barrier: orders earlier stores before later loads.
+ */
+#define __mem_barrier() __asm__ __volatile__("mfence" ::: "memory")
+
+/* 
+ * Spin-wait hint to the processor.
+ */
+#define __cpu_relax() __asm__ __volatile__("pause" ::: "memory")
+
 #endif
@@ -44,7 +44,35 @@ typedef enum
 	/**
 	 * Reaper is ready to consume
 	 */
-	LWT_INFO_REAPER_READY
+	LWT_INFO_REAPER_READY,
+	/**
+	 * Number of event batches drained by the reaper of the current kthd
+	 */
+	LWT_INFO_KTHD_BATCHES,
+	/**
+	 * Number of remote events processed by the reaper of the current kthd
+	 */
+	LWT_INFO_KTHD_EVENTS,
+	/**
+	 * Largest batch of events drained by the reaper of the current kthd
+	 */
+	LWT_INFO_KTHD_MAX_BATCH,
+	/**
+	 * Number of duplicate wakeups coalesced by the reaper of the current kthd
+	 */
+	LWT_INFO_KTHD_COALESCED,
+	/**
+	 * Number of lwts on the current kthd woken by other kthds through its wake stack
+	 */
+	LWT_INFO_KTHD_WAKEUPS,
+	/**
+	 * Number of readinesses of descriptors watched by the current kthd pushed into their channels
+	 */
+	LWT_INFO_KTHD_WATCH_EVENTS,
+	/**
+	 * Number of times the scheduler ran the reaper of the current kthd ahead of runnable lwts
+	 */
+	LWT_INFO_KTHD_POLLS
 } lwt_info_t;
 
 
@@ -65,13 +93,9 @@ typedef enum{
 
 typedef enum{
 	/**
-	 * Add a lwt sender to a channel
-	 */
-	LWT_REMOTE_ADD_SENDER_TO_CHANNEL,
-	/**
-	 * Remove a lwt sender to a channel
+	 * Free a channel whose last reference was dropped
 	 */
-	LWT_REMOTE_REMOVE_SENDER_FROM_CHANNEL,
+	LWT_REMOTE_FREE_CHANNEL,
 	/**
 	 * Add a blocked lwt to a channel
 	 */
@@ -97,9 +121,169 @@ typedef enum{
 	 */
 	LWT_REMOTE_REMOVE_EVENT_FROM_GROUP,
 	/**
-	 * Signal
+	 * Park a select case on a channel
+	 */
+	LWT_REMOTE_ADD_SELECTOR_TO_CHANNEL,
+	/**
+	 * Remove a parked select case from a channel
+	 */
+	LWT_REMOTE_REMOVE_SELECTOR_FROM_CHANNEL,
+	/**
+	 * Park a receiver on a multi-consumer channel
+	 */
+	LWT_REMOTE_ADD_BLOCKED_RECEIVER_TO_CHANNEL,
+	/**
+	 * Remove a parked receiver from a multi-consumer channel
+	 */
+	LWT_REMOTE_REMOVE_BLOCKED_RECEIVER_FROM_CHANNEL,
+	/**
+	 * Wake whoever is parked on a multi-consumer channel and can now go ahead
+	 */
+	LWT_REMOTE_WAKE_CHANNEL,
+	/**
+	 * Wake the head of the lwts parked on a buffer pool
 	 */
-	LWT_REMOTE_SIGNAL
+	LWT_REMOTE_WAKE_BUF_POOL
 }lwt_remote_op_t;
 
+/**
+ * @brief Idle policies for the reaper when a kthd has no runnable lwts
+ */
+typedef enum{
+	/**
+	 * Spin on the event buffer for an adaptive window, then sleep until an event is pushed
+	 */
+	LWT_KTHD_IDLE_ADAPTIVE,
+	/**
+	 * Never sleep; busy-poll the event buffer (for kthds pinned to dedicated cores)
+	 */
+	LWT_KTHD_IDLE_POLL
+}lwt_kthd_idle_t;
+
+/**
+ * @brief Kinds of channels
+ */
+typedef enum{
+	/**
+	 * Any number of senders; synchronous if the buffer size is 0
+	 */
+	LWT_CHAN_DEFAULT,
+	/**
+	 * Buffered channel with exactly one sender; no sender bookkeeping
+	 */
+	LWT_CHAN_SPSC,
+	/**
+	 * Buffered channel copying fixed-size messages inline into its slots
+	 */
+	LWT_CHAN_TYPED,
+	/**
+	 * Buffered channel any number of lwts, on any kthds, can receive from
+	 */
+	LWT_CHAN_MPMC,
+	/**
+	 * Buffered channel whose buffer doubles instead of blocking senders and shrinks again when mostly empty
+	 */
+	LWT_CHAN_GROW
+}lwt_chan_type_t;
+
+/**
+ * @brief When a channel of a group is reported as ready
+ */
+typedef enum{
+	/**
+	 * Report the channel when data arrives; the event is consumed by the wait that drains it
+	 */
+	LWT_CGRP_EDGE,
+	/**
+	 * Report the channel on every wait for as long as it has data
+	 */
+	LWT_CGRP_LEVEL
+}lwt_cgrp_trigger_t;
+
+/**
+ * @brief The operation of a select case
+ */
+typedef enum{
+	/**
+	 * Send the data of the case
+	 */
+	LWT_SELECT_SND,
+	/**
+	 * Receive into the data of the case
+	 */
+	LWT_SELECT_RCV
+}lwt_select_op_t;
+
+/**
+ * @brief What a broadcast producer does when the slowest subscriber is a full ring behind
+ */
+typedef enum{
+	/**
+	 * Wait until the slowest subscriber catches up
+	 */
+	LWT_BCAST_BLOCK,
+	/**
+	 * Overwrite the oldest message; subscribers that hadn't received it skip it
+	 */
+	LWT_BCAST_DROP_OLDEST
+}lwt_bcast_policy_t;
+
+/**
+ * @brief The runtime objects and lwt_malloc size classes each kthd keeps a slab cache for
+ */
+typedef enum{
+	/**
+	 * Channels
+	 */
+	LWT_SLAB_CHAN,
+	/**
+	 * Channel groups
+	 */
+	LWT_SLAB_CGRP,
+	/**
+	 * Ring descriptors
+	 */
+	LWT_SLAB_RING,
+	/**
+	 * Single-producer single-consumer ring descriptors
+	 */
+	LWT_SLAB_SPSC,
+	/**
+	 * lwt_malloc memory up to 32 bytes; the size classes double from here
+	 */
+	LWT_SLAB_MALLOC_32,
+	/**
+	 * lwt_malloc memory up to 64 bytes
+	 */
+	LWT_SLAB_MALLOC_64,
+	/**
+	 * lwt_malloc memory up to 128 bytes
+	 */
+	LWT_SLAB_MALLOC_128,
+	/**
+	 * lwt_malloc memory up to 256 bytes
+	 */
+	LWT_SLAB_MALLOC_256,
+	/**
+	 * lwt_malloc memory up to 512 bytes
+	 */
+	LWT_SLAB_MALLOC_512,
+	/**
+	 * lwt_malloc memory up to 1024 bytes
+	 */
+	LWT_SLAB_MALLOC_1024,
+	/**
+	 * lwt_malloc memory up to 2048 bytes
+	 */
+	LWT_SLAB_MALLOC_2048,
+	/**
+	 * lwt_malloc memory up to 4096 bytes
+	 */
+	LWT_SLAB_MALLOC_4096,
+	/**
+	 * Number of slab caches
+	 */
+	LWT_SLAB_NUM_CACHES
+}lwt_slab_cache_t;
+
 #endif /* ENUMS_H_ */
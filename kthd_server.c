@@ -8,9 +8,9 @@
 #include "kthd_server.h"
 #include "search.h"
 
-#include "lwt_cgrp.h"
 #include "lwt_chan.h"
 #include "lwt_kthd.h"
+#include "lwt_call.h"
 #include "objects.h"
 
 #include "simple_http.h"
@@ -22,6 +22,7 @@
 #include "unistd.h"
 #include "assert.h"
 #include "string.h"
+#include "errno.h"
 
 #define MAX_CACHE_ENTRIES 10
 #define POOL_SIZE 2
@@ -112,26 +113,28 @@ newfd_create_req_kthd(int new_fd)
 	return r;
 }
 
+/**
+ * @brief A file system request from a cache worker
+ */
+struct fs_req{
+	/**
+	 * The path to read
+	 */
+	char * path;
+	/**
+	 * Set to the length of the content
+	 */
+	int len;
+};
+
 /**
  * @brief Processes the file system request; used for thread pool
- * @param cache_channel The channel to receive
- * @return NULL
+ * @param call The call from the cache worker
  */
-void * read_fs(lwt_chan_t cache_channel){
-	//create channel; probably not the best method for this but instructions said to use thread pool
-	lwt_chan_t fs_channel = lwt_chan(2);
-	//send it
-	lwt_snd_chan(cache_channel, fs_channel);
-	//read data
-	char * data = (char *)lwt_rcv(fs_channel);
-	int * len = (int *)lwt_rcv(fs_channel);
-	char * response = content_get(data, len);
-	//send data back
-	lwt_snd(cache_channel, response);
-	//clean up
-	lwt_chan_deref(fs_channel);
-	lwt_chan_deref(cache_channel);
-	return NULL;
+void read_fs(lwt_call_t call){
+	struct fs_req * req = (struct fs_req *)lwt_call_req(call);
+	//read data and send it back
+	lwt_reply(call, content_get(req->path, &req->len));
 }
 
 /**
@@ -140,23 +143,25 @@ void * read_fs(lwt_chan_t cache_channel){
  */
 void * spawn_fs_workers(lwt_chan_t main_channel){
 	//create channel
-	lwt_chan_t spawn_channel = lwt_chan(3);
-	assert(spawn_channel);
-	//send channel to main
-	lwt_snd_chan(main_channel, spawn_channel);
+	lwt_chan_t fs_channel = lwt_chan(LWT_CACHE);
+	assert(fs_channel);
+	//send channel to main; the cache workers call it directly
+	lwt_snd_chan(main_channel, fs_channel);
 
-	lwt_chan_t cache_channel;
-	//spawn fs workers
 	while(1){
-		cache_channel = lwt_rcv(spawn_channel);
-		read_fs(cache_channel);
+		read_fs(lwt_rcv_call(fs_channel));
 	}
 
 	lwt_chan_deref(main_channel);
-	lwt_chan_deref(spawn_channel);
+	lwt_chan_deref(fs_channel);
 
 	return NULL;
 }
+/**
+ * @brief The fs worker the next cache miss goes to; the cache workers share it on the cache kthd
+ */
+static __thread unsigned int fs_next = 0;
+
 /**
  * @brief LWT function for caching; checks if the path has been cached; if so, return it; else hit fs threads
  * @param kthd_channel The channel for the spawner
@@ -169,21 +174,25 @@ void * read_cache(lwt_chan_t kthd_channel){
 	int accept_fd;
 
 	struct http_req *r;
-	int len;
+	struct fs_req req;
 
 	int num_hash_entries = 0;
 
+	int i;
+
 	//set up channels
-	lwt_chan_t my_channel = lwt_chan(3);
+	lwt_chan_t my_channel = lwt_chan(1 + POOL_SIZE);
 	assert(my_channel);
 	lwt_snd_chan(kthd_channel, my_channel);
 
-	lwt_chan_t main_channel = lwt_rcv_chan(my_channel);
+	lwt_chan_t work_channel = lwt_rcv_chan(my_channel);
+	lwt_chan_t fs_channels[POOL_SIZE];
+	for(i = 0; i < POOL_SIZE; ++i){
+		fs_channels[i] = lwt_rcv_chan(my_channel);
+	}
 
 
 	char * data;
-	lwt_chan_t fs_channel;
-	lwt_chan_t response_channel = lwt_chan(0);
 
 
 	//create hash
@@ -192,8 +201,8 @@ void * read_cache(lwt_chan_t kthd_channel){
 
 
 	while(1){
-		//wait for request
-		accept_fd = (int)lwt_rcv(my_channel);
+		//wait for request; whichever cache worker is idle takes it
+		accept_fd = (int)lwt_rcv(work_channel);
 
 		/*
 		 * This code will be used to get the request and respond to
@@ -219,17 +228,9 @@ void * read_cache(lwt_chan_t kthd_channel){
 		}
 		else
 		{
-			//we need to request it from one of the fs queues
-			lwt_snd_chan(main_channel, response_channel);
-			//wait for worker channel
-			fs_channel = lwt_rcv_chan(response_channel);
-			//send the path
-			lwt_snd(fs_channel, r->path);
-			lwt_snd(fs_channel, &len);
-			//receive the response
-			data = lwt_rcv(response_channel);
-			//remove from channel
-			lwt_chan_deref(fs_channel);
+			//we need to request it from an fs worker; take turns so no worker is tied to one of them
+			req.path = r->path;
+			data = lwt_call(fs_channels[fs_next++ % POOL_SIZE], &req);
 			//insert data into cache if there's capacity
 			if(num_hash_entries < MAX_CACHE_ENTRIES){
 				query.data = (char *)calloc(MAX_REQ_SZ, sizeof(char));
@@ -240,11 +241,13 @@ void * read_cache(lwt_chan_t kthd_channel){
 				num_hash_entries++;
 			}
 		}
-		respond_and_free_req_kthd(r, data, len);
+		respond_and_free_req_kthd(r, data, req.len);
 	}
 	//cleanup
-	lwt_chan_deref(main_channel);
-	lwt_chan_deref(response_channel);
+	lwt_chan_deref(work_channel);
+	for(i = 0; i < POOL_SIZE; ++i){
+		lwt_chan_deref(fs_channels[i]);
+	}
 	lwt_chan_deref(my_channel);
 
 	return NULL;
@@ -256,55 +259,51 @@ void * read_cache(lwt_chan_t kthd_channel){
  * @return NULL
  */
 void * read_cache_kthd(lwt_chan_t main_channel){
-	//create cache channel
-	lwt_chan_t cache_channels[MAX_ACCEPTORS];
-	lwt_cgrp_t accept_group = lwt_cgrp();
-	int i;
-	for(i = 0; i < MAX_ACCEPTORS; ++i){
-		cache_channels[i] = lwt_chan(3);
-		lwt_cgrp_add(accept_group, cache_channels[i]);
-		//send back to main channel
-		lwt_snd_chan(main_channel, cache_channels[i]);
-	}
-
 	lwt_chan_t my_channel = lwt_chan(10);
 	assert(my_channel);
+	//receive the fs workers from main
+	lwt_snd_chan(main_channel, my_channel);
+	lwt_chan_t fs_channels[POOL_SIZE];
+	int i, j;
+	for(i = 0; i < POOL_SIZE; ++i){
+		fs_channels[i] = lwt_rcv_chan(my_channel);
+	}
+
+	//create the work queue; the acceptors push into it and idle cache workers pull from it
+	lwt_chan_t work_channel = lwt_chan_mpmc(MAX_ACCEPTORS * LWT_CACHE);
+	assert(work_channel);
+	//send back to main channel
+	lwt_snd_chan(main_channel, work_channel);
 
 	lwt_chan_t worker_channels[LWT_CACHE];
 	for(i = 0; i < LWT_CACHE; ++i){
 		lwt_create_chan(read_cache, my_channel, LWT_NOJOIN);
 		worker_channels[i] = lwt_rcv_chan(my_channel);
-		lwt_snd_chan(worker_channels[i], main_channel);
-	}
-
-	lwt_chan_t accept_channel;
-	int fd;
-
-	i = 0;
-	while(1){
-		//hey hey hey! here's the group wait!
-		accept_channel = lwt_cgrp_wait(accept_group);
-		fd = (int)lwt_rcv(accept_channel);
-		lwt_snd(worker_channels[i], (void *)fd);
-		i++;
-		if(i >= LWT_CACHE){
-			i = 0;
+		lwt_snd_chan(worker_channels[i], work_channel);
+		//every worker can call every fs worker
+		for(j = 0; j < POOL_SIZE; ++j){
+			lwt_snd_chan(worker_channels[i], fs_channels[j]);
 		}
 	}
-	//cleanup
-	for(i = 0; i < MAX_ACCEPTORS; ++i){
-		lwt_chan_deref(cache_channels[i]);
-	}
+	//cleanup; the workers keep the kthd, the work queue and the fs workers alive
 	for(i = 0; i < LWT_CACHE; ++i){
 		lwt_chan_deref(worker_channels[i]);
 	}
+	for(i = 0; i < POOL_SIZE; ++i){
+		lwt_chan_deref(fs_channels[i]);
+	}
+	lwt_chan_deref(work_channel);
 	lwt_chan_deref(my_channel);
+	lwt_chan_deref(main_channel);
+
+	return NULL;
 }
 
 /**
  * @brief Accept worker kthd; accepts the new httd request
  * @param main_channel The channel to send data across
  * @return NULL
+ * @note Exits once the listening socket is closed, reporting to main over main_channel
  */
 void * accept_worker(lwt_chan_t main_channel){
 	int server_fd;
@@ -313,24 +312,27 @@ void * accept_worker(lwt_chan_t main_channel){
 	//send to main channel
 	lwt_snd_chan(main_channel, worker_channel);
 
-	//receive cache channels
-	lwt_chan_t cache_channels[MAX_ACCEPTORS];
-	int i;
-	for(i = 0; i < MAX_ACCEPTORS; ++i){
-		cache_channels[i] = lwt_rcv_chan(worker_channel);
-	}
+	//receive the cache work queue
+	lwt_chan_t work_channel = lwt_rcv_chan(worker_channel);
 
-	i = 0;
-	//receive file descriptor; send to cache round robin style
+	//receive file descriptor; hand requests to whichever cache worker is idle
 	int fd = (int)lwt_rcv(worker_channel);
 	while(1){
 		server_fd = server_accept(fd);
-		lwt_snd(cache_channels[i], (void *)server_fd);
-		i++;
-		if(i >= MAX_ACCEPTORS){
-			i = 0;
+		if(server_fd >= 0){
+			lwt_snd(work_channel, (void *)server_fd);
+			continue;
+		}
+		//aborted connections and running out of descriptors pass; a closed socket doesn't
+		if(errno == EBADF || errno == EINVAL){
+			break;
 		}
 	}
+	lwt_chan_deref(work_channel);
+	lwt_chan_deref(worker_channel);
+	lwt_snd(main_channel, NULL);
+	lwt_chan_deref(main_channel);
+	return NULL;
 }
 
 /**
@@ -341,43 +343,43 @@ void process_kthd_server(int accept_fd){
 	//create channel
 	lwt_chan_t main_channel = lwt_chan(20);
 	lwt_chan_t fs_channels[POOL_SIZE];
-	lwt_chan_t cache_channels[MAX_ACCEPTORS];
+	lwt_chan_t cache_channel;
+	lwt_chan_t work_channel;
 	lwt_chan_t accept_channels[MAX_ACCEPTORS];
 	//create fs threadpool
-	int i, j;
+	int i;
 	for(i = 0; i < POOL_SIZE; ++i){
 		assert(!lwt_kthd_create(spawn_fs_workers, main_channel, LWT_NOJOIN));
 		fs_channels[i] = lwt_rcv_chan(main_channel);
 	}
 
-	//create the cache kthd
+	//create the cache kthd and hand it the fs workers
 	assert(!lwt_kthd_create(read_cache_kthd, main_channel, LWT_NOJOIN));
-	for(i = 0; i < MAX_ACCEPTORS; ++i){
-		cache_channels[i] = lwt_rcv_chan(main_channel);
+	cache_channel = lwt_rcv_chan(main_channel);
+	for(i = 0; i < POOL_SIZE; ++i){
+		lwt_snd_chan(cache_channel, fs_channels[i]);
+		lwt_chan_deref(fs_channels[i]);
 	}
+	lwt_chan_deref(cache_channel);
+	work_channel = lwt_rcv_chan(main_channel);
 	//create the acceptors
 	i = 0;
 	for(i = 0; i < MAX_ACCEPTORS; ++i){
 		assert(!lwt_kthd_create(accept_worker, main_channel, LWT_NOJOIN));
 		accept_channels[i] = lwt_rcv_chan(main_channel);
-		//send cache channels
-		for(j = 0; j < MAX_ACCEPTORS; ++j){
-			lwt_snd_chan(accept_channels[i], cache_channels[j]);
-		}
+		//send the cache work queue
+		lwt_snd_chan(accept_channels[i], work_channel);
 		//send file descriptor
 		lwt_snd(accept_channels[i], (void *)accept_fd);
+		lwt_chan_deref(accept_channels[i]);
 	}
+	lwt_chan_deref(work_channel);
 
-	//rcv calls to spawn threads; round robin
-	lwt_chan_t fs_read_channel;
-	i = 0;
-	while(1){
-		fs_read_channel = lwt_rcv_chan(main_channel);
-		lwt_snd_chan(fs_channels[i], fs_read_channel);
-		i++;
-		if(i >= POOL_SIZE){
-			i = 0;
-		}
+	//the cache workers call the fs workers directly, so there's nothing left to relay. Returning would
+	//let main close the socket and exit with every kthd still serving, so hold on until the acceptors
+	//have given up on the socket
+	for(i = 0; i < MAX_ACCEPTORS; ++i){
+		lwt_rcv(main_channel);
 	}
-
+	lwt_chan_deref(main_channel);
 }
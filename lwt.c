@@ -2,6 +2,9 @@
 #include "lwt_chan.h"
 #include "lwt_cgrp.h"
 #include "lwt_kthd.h"
+#include "lwt_ring.h"
+#include "lwt_slab.h"
+#include "faa.h"
 
 #include "pthread.h"
 
@@ -21,6 +24,12 @@
  * @brief The size of the pool
  */
 #define POOL_SIZE 100
+/**
+ * @brief Number of dispatches between checks for remote events while the kthd is busy
+ */
+#ifndef KTHD_POLL_INTERVAL
+#define KTHD_POLL_INTERVAL 64
+#endif
 
 /**
  * @brief Dispatch function for switching between threads
@@ -105,6 +114,24 @@ lwt_t inline lwt_current(){
 int lwt_info(lwt_info_t t){
 	int count = 0;
 	lwt_t current_thread = head_current.lh_first;
+	switch(t){
+	case LWT_INFO_KTHD_BATCHES:
+		return __get_kthd()->num_batches;
+	case LWT_INFO_KTHD_EVENTS:
+		return __get_kthd()->num_events;
+	case LWT_INFO_KTHD_MAX_BATCH:
+		return __get_kthd()->max_batch;
+	case LWT_INFO_KTHD_COALESCED:
+		return __get_kthd()->num_coalesced;
+	case LWT_INFO_KTHD_WAKEUPS:
+		return __get_kthd()->num_remote_wakeups;
+	case LWT_INFO_KTHD_WATCH_EVENTS:
+		return __get_kthd()->num_watch_events;
+	case LWT_INFO_KTHD_POLLS:
+		return __get_kthd()->num_polls;
+	default:
+		break;
+	}
 	if(t == LWT_INFO_NCHAN){
 		while(current_thread){
 			lwt_chan_t current_channel = current_thread->head_receiver_channel.lh_first;
@@ -158,6 +185,11 @@ void __init_lwt_main(lwt_t thread){
 
 	thread->info = LWT_INFO_NTHD_RUNNABLE;
 	thread->kthd = __get_kthd();
+	thread->is_blocked_sender = 0;
+	thread->is_blocked_receiver = 0;
+	thread->sync_buffer = NULL;
+	thread->wake_next = NULL;
+	thread->wake_queued = 0;
 }
 
 /**
@@ -176,6 +208,10 @@ void __init_new_lwt(lwt_t thread){
 	//init receiving channels
 	LIST_INIT(&thread->head_receiver_channel);
 
+	//not on any wake stack; only the wake stack protocol touches these afterwards
+	thread->wake_next = NULL;
+	thread->wake_queued = 0;
+
 	//add to the list of threads
 	LIST_INSERT_HEAD(&head_current, thread, current_threads);
 }
@@ -188,14 +224,7 @@ void __reinit_lwt(lwt_t thread){
 	//set id
 	thread->id = get_new_id(); //return id and increment TODO implement atomically
 
-	thread->thread_sp = thread->max_addr_thread_stack - 1;
-	//add the function
-	*(thread->thread_sp--) = (long)(__lwt_trampoline);
-
-	*(thread->thread_sp--) = (long)0; //ebp
-	*(thread->thread_sp--) = (long)0;//ebx
-	*(thread->thread_sp--) = (long)0;//edi
-	*(thread->thread_sp) = (long)0;//esi
+	//the initial frame is laid out in lwt_create; a dying NOJOIN lwt is still running on this stack
 
 	//set up parent
 	thread->parent = NULL;
@@ -208,6 +237,9 @@ void __reinit_lwt(lwt_t thread){
 
 	//reset flags to 0
 	thread->flags = LWT_JOIN;
+	thread->is_blocked_sender = 0;
+	thread->is_blocked_receiver = 0;
+	thread->sync_buffer = NULL;
 
 	//add to ready pool
 	thread->info = LWT_INFO_NTHD_READY_POOL;
@@ -334,17 +366,41 @@ void lwt_block(lwt_info_t info){
 void lwt_signal(lwt_t thread){
 	assert(thread);
 	if(__get_kthd() == thread->kthd){
-		if(thread->info != LWT_INFO_NTHD_RUNNABLE){
+		//remote wakeups can still be in flight when the lwt dies; never revive a dead lwt
+		if(thread->info != LWT_INFO_NTHD_RUNNABLE && thread->info != LWT_INFO_NTHD_ZOMBIES &&
+				thread->info != LWT_INFO_NTHD_READY_POOL){
 			thread->info = LWT_INFO_NTHD_RUNNABLE;
 			//insert at head
 			TAILQ_INSERT_HEAD(&__get_kthd()->head_runnable_threads, thread, runnable_threads);
 		}
 	}
 	else{
-		__init_kthd_event(thread, NULL, NULL, thread->kthd, LWT_REMOTE_SIGNAL, 0);
+		__push_remote_wakeup(thread);
 	}
 }
 
+/**
+ * @brief Signals the non-running thread to run as soon as the current one blocks or yields
+ * @param thread The thread to be woken
+ * @note A same-kthd rendezvous hands the kthd straight to the other side this way, without going through
+ * the run queue; anything else falls back to lwt_signal
+ */
+void __lwt_signal_next(lwt_t thread){
+	lwt_kthd_t kthd = __get_kthd();
+	if(thread->kthd != kthd || current_thread == kthd->buffer_thread ||
+			thread->info == LWT_INFO_NTHD_RUNNABLE || thread->info == LWT_INFO_NTHD_ZOMBIES ||
+			thread->info == LWT_INFO_NTHD_READY_POOL){
+		lwt_signal(thread);
+		return;
+	}
+	//the one woken before still goes first, like lwt_signal's insert at the head
+	if(kthd->next_thread){
+		TAILQ_INSERT_HEAD(&kthd->head_runnable_threads, kthd->next_thread, runnable_threads);
+	}
+	thread->info = LWT_INFO_NTHD_RUNNABLE;
+	kthd->next_thread = thread;
+}
+
 /**
  * @brief Yields to the provided LWT
  * @param lwt The thread to yield to
@@ -364,7 +420,12 @@ int lwt_yield(lwt_t lwt){
 		current_thread = lwt;
 		//remove it from the runqueue
 		//remove_from_runnable_threads(lwt);
-		TAILQ_REMOVE(&__get_kthd()->head_runnable_threads, lwt, runnable_threads);
+		if(__get_kthd()->next_thread == lwt){
+			__get_kthd()->next_thread = NULL;
+		}
+		else{
+			TAILQ_REMOVE(&__get_kthd()->head_runnable_threads, lwt, runnable_threads);
+		}
 		//put it out in front
 		//insert_runnable_head(curr_thread);
 		TAILQ_INSERT_HEAD(&__get_kthd()->head_runnable_threads, curr_thread, runnable_threads);
@@ -380,7 +441,40 @@ int lwt_yield(lwt_t lwt){
 void __lwt_schedule(){
 	//assert(__get_kthd()->head_runnable_threads.tqh_first);
 	//assert(__get_kthd()->head_runnable_threads.tqh_first != current_thread);
-	if(__get_kthd()->head_runnable_threads.tqh_first != NULL &&
+	lwt_kthd_t kthd = __get_kthd();
+	//bound the latency of remote events while local lwts keep the kthd busy
+	if(current_thread != kthd->buffer_thread && ++kthd->num_dispatches >= KTHD_POLL_INTERVAL){
+		kthd->num_dispatches = 0;
+		//watched descriptors can only be seen by asking epoll
+		if(__kthd_has_events(kthd) || kthd->num_watches){
+			lwt_t curr_thread = current_thread;
+			//the reaper only looks at the run queue
+			if(kthd->next_thread){
+				TAILQ_INSERT_HEAD(&kthd->head_runnable_threads, kthd->next_thread, runnable_threads);
+				kthd->next_thread = NULL;
+			}
+			if(current_thread->info == LWT_INFO_NTHD_RUNNABLE){
+				__insert_runnable_tail(current_thread);
+			}
+			kthd->num_polls++;
+			kthd->buffer_thread->info = LWT_INFO_NTHD_RUNNABLE;
+			current_thread = kthd->buffer_thread;
+			__lwt_dispatch(kthd->buffer_thread, curr_thread);
+			return;
+		}
+	}
+	if(kthd->next_thread){
+		lwt_t curr_thread = current_thread;
+		lwt_t next_thread = kthd->next_thread;
+		//straight to the other side of a rendezvous; it never went on the run queue
+		kthd->next_thread = NULL;
+		if(current_thread->info == LWT_INFO_NTHD_RUNNABLE){
+			__insert_runnable_tail(current_thread);
+		}
+		current_thread = next_thread;
+		__lwt_dispatch(next_thread, curr_thread);
+	}
+	else if(__get_kthd()->head_runnable_threads.tqh_first != NULL &&
 			__get_kthd()->head_runnable_threads.tqh_first != current_thread){
 		lwt_t curr_thread = current_thread;
 		//move current thread to the end of the queue
@@ -403,9 +497,11 @@ void __lwt_schedule(){
 		lwt_t curr_thread = current_thread;
 		lwt_t next_thread = __get_kthd()->buffer_thread;
 		__get_kthd()->buffer_thread->info = LWT_INFO_NTHD_RUNNABLE;
-		TAILQ_REMOVE(&__get_kthd()->head_runnable_threads, next_thread, runnable_threads);
-		current_thread = next_thread;
-		__lwt_dispatch(next_thread, curr_thread);
+		//the reaper is never on the run queue; it may also be the one blocking
+		if(next_thread != curr_thread){
+			current_thread = next_thread;
+			__lwt_dispatch(next_thread, curr_thread);
+		}
 	}
 }
 
@@ -441,9 +537,6 @@ __attribute__((constructor)) void __init__(){
 	LIST_REMOVE(pthread_kthd->buffer_thread, siblings);
 	LIST_REMOVE(pthread_kthd->buffer_thread, lwts_in_kthd);
 	//pthread_kthd->buffer_thread->info = LWT_INFO_NTHD_BLOCKED;
-	//set up mutex and cv
-	pthread_mutex_init(&pthread_kthd->blocked_mutex, NULL);
-	pthread_cond_init(&pthread_kthd->blocked_cv, NULL);
 }
 
 /**
@@ -474,6 +567,9 @@ __attribute__((destructor)) void __destroy__(){
 	current = head_current.lh_first;
 	next = NULL;
 
+	//from here on other kthds handle what they post to us themselves; what they posted before is done
+	__kthd_exit(pthread_kthd);
+
 	while(current){
 		next = current->current_threads.le_next;
 
@@ -481,10 +577,7 @@ __attribute__((destructor)) void __destroy__(){
 		rcv_channels = current->head_receiver_channel.lh_first;
 		while(rcv_channels){
 			next_channel = rcv_channels->receiver_channels.le_next;
-			//free buffer
-			if(rcv_channels->async_buffer){
-				free(rcv_channels->async_buffer);
-			}
+			rcv_channels->receiver = NULL;
 			//free group
 			lwt_cgrp_t group = rcv_channels->channel_group;
 			if(group && group->creator_thread == current){
@@ -492,9 +585,13 @@ __attribute__((destructor)) void __destroy__(){
 				while(group->head_event.tqh_first){
 					TAILQ_REMOVE(&group->head_event, group->head_event.tqh_first, events);
 				}
-				free(group);
+				__slab_free(LWT_SLAB_CGRP, group);
+			}
+			rcv_channels->channel_group = NULL;
+			//senders on other kthds may still hold the channel; the last of them frees it
+			if(fetch_and_add((volatile unsigned int *)&rcv_channels->ref_cnt, -1) == 1){
+				__free_chan(rcv_channels);
 			}
-			free(rcv_channels);
 			rcv_channels = next_channel;
 		}
 
@@ -511,10 +608,8 @@ __attribute__((destructor)) void __destroy__(){
 
 	//free original thread
 	free(original_thread);
-	//free kthd
-	pthread_cond_destroy(&pthread_kthd->blocked_cv);
-	pthread_mutex_destroy(&pthread_kthd->blocked_mutex);
-	free(pthread_kthd);
+	//the kthd stays until objects carved from its slab caches that outlive it are handed back
+	__slab_exit(pthread_kthd);
 
 	pthread_exit(0);
 }
@@ -535,6 +630,16 @@ lwt_t lwt_create(lwt_fnt_t fn, void * data, lwt_flags_t flags){
 	//pop the head of the ready pool list
 	lwt_t thread = head_ready_pool_threads.lh_first;
 	LIST_REMOVE(thread, ready_pool_threads);
+
+	thread->thread_sp = thread->max_addr_thread_stack - 1;
+	//add the function
+	*(thread->thread_sp--) = (long)(__lwt_trampoline);
+
+	*(thread->thread_sp--) = (long)0; //ebp
+	*(thread->thread_sp--) = (long)0;//ebx
+	*(thread->thread_sp--) = (long)0;//edi
+	*(thread->thread_sp) = (long)0;//esi
+
 	//set thread's parent
 	thread->parent = current_thread;
 	//insert into parent's siblings
@@ -21,6 +21,8 @@ int lwt_info(lwt_info_t);
 void lwt_block(lwt_info_t);
 void lwt_signal(lwt_t);
 
+void __lwt_signal_next(lwt_t);
+
 void __init__();
 void __destroy__();
 
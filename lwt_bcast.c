@@ -0,0 +1,313 @@
+/*
+ * lwt_bcast.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_bcast.h"
+#include "lwt.h"
+#include "lwt_slab.h"
+
+#include "objects.h"
+
+#include "stdlib.h"
+#include "string.h"
+#include "assert.h"
+#include "faa.h"
+#include "cas.h"
+
+/**
+ * @brief Wakes the producer if it is parked waiting for subscribers
+ * @param b The broadcast channel
+ */
+static void __bcast_wake_producer(lwt_bcast_t b){
+	if(b->producer_blocked && !__cas(&b->producer_blocked, 1, 0)){
+		lwt_signal(b->producer);
+	}
+}
+
+/**
+ * @brief Wakes every parked subscriber; each one drains all it can before parking again
+ * @param b The broadcast channel
+ */
+static void __bcast_wake_subs(lwt_bcast_t b){
+	unsigned int index;
+	struct lwt_bcast_sub * sub;
+	//publish the head before looking for parked subscribers; they park before rechecking it
+	__mem_barrier();
+	if(!b->num_blocked){
+		return;
+	}
+	for(index = 0; index < b->max_subs; ++index){
+		sub = &b->subs[index];
+		if(sub->is_active && sub->is_blocked && !__cas(&sub->is_blocked, 1, 0)){
+			fetch_and_add(&b->num_blocked, -1);
+			lwt_signal(sub->lwt);
+		}
+	}
+}
+
+/**
+ * @brief Gets the cursor of the slowest subscriber
+ * @param b The broadcast channel
+ * @return The smallest cursor; the head if there are no subscribers
+ */
+static unsigned long __bcast_min_cursor(lwt_bcast_t b){
+	unsigned long head = b->head, min_cursor = head;
+	unsigned int index;
+	for(index = 0; index < b->max_subs; ++index){
+		if(b->subs[index].is_active && head - b->subs[index].cursor > head - min_cursor){
+			min_cursor = b->subs[index].cursor;
+		}
+	}
+	return min_cursor;
+}
+
+/**
+ * @brief Waits until the slowest subscriber leaves room for the next message
+ * @param b The broadcast channel
+ */
+static void __bcast_wait_room(lwt_bcast_t b){
+	while(b->head - b->min_cursor >= b->capacity){
+		b->min_cursor = __bcast_min_cursor(b);
+		if(b->head - b->min_cursor < b->capacity){
+			return;
+		}
+		//subscribers parked on what's already published have to run to make room
+		__bcast_wake_subs(b);
+		b->producer_blocked = 1;
+		__mem_barrier();
+		b->min_cursor = __bcast_min_cursor(b);
+		if(b->head - b->min_cursor < b->capacity){
+			if(__cas(&b->producer_blocked, 1, 0)){
+				//a subscriber is already waking us up
+				lwt_block(LWT_INFO_NSENDING);
+			}
+			return;
+		}
+		lwt_block(LWT_INFO_NSENDING);
+	}
+}
+
+/**
+ * @brief Receives the next message if there is one
+ * @param sub The subscription
+ * @param data Set to the message
+ * @return 0 if a message was received; -1 if the subscriber is caught up
+ */
+static int __bcast_take(lwt_bcast_sub_t sub, void ** data){
+	lwt_bcast_t b = sub->bcast;
+	unsigned long cursor = sub->cursor, tail;
+	while(cursor != b->head){
+		*data = b->slots[cursor & b->mask];
+		//loads aren't reordered with loads; if the slot was overwritten, the claim moved the tail past it first
+		__compiler_barrier();
+		tail = b->tail;
+		if(tail - cursor > b->capacity){
+			//overwritten; skip to the oldest message still in the ring
+			sub->num_dropped += (tail - b->capacity) - cursor;
+			cursor = tail - b->capacity;
+			continue;
+		}
+		sub->cursor = cursor + 1;
+		if(b->policy == LWT_BCAST_BLOCK){
+			//the producer parks before rescanning the cursors
+			__mem_barrier();
+			__bcast_wake_producer(b);
+		}
+		return 0;
+	}
+	sub->cursor = cursor;
+	return -1;
+}
+
+/**
+ * @brief Creates a broadcast channel; the current lwt is its producer
+ * @param capacity The number of messages held for the slowest subscriber; rounded up to a power of two
+ * @param max_subs The most subscribers the channel can have at once
+ * @param policy What the producer does when the slowest subscriber is a full ring behind
+ * @return The broadcast channel; NULL if it couldn't be allocated
+ */
+lwt_bcast_t lwt_chan_bcast(unsigned int capacity, unsigned int max_subs, lwt_bcast_policy_t policy){
+	void * mem;
+	lwt_bcast_t b;
+	unsigned int size = 2;
+	assert(capacity > 0 && max_subs > 0);
+	while(size < capacity){
+		size <<= 1;
+	}
+	if(posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(struct lwt_bcast))){
+		return NULL;
+	}
+	b = (lwt_bcast_t)mem;
+	b->slots = (void * volatile *)lwt_malloc(size * sizeof(void *));
+	if(!b->slots){
+		free(b);
+		return NULL;
+	}
+	memset((void *)b->slots, 0, size * sizeof(void *));
+	if(posix_memalign(&mem, CACHE_LINE_SIZE, max_subs * sizeof(struct lwt_bcast_sub))){
+		lwt_free((void *)b->slots);
+		free(b);
+		return NULL;
+	}
+	b->subs = (struct lwt_bcast_sub *)mem;
+	b->capacity = size;
+	b->mask = size - 1;
+	b->policy = policy;
+	b->producer = lwt_current();
+	b->max_subs = max_subs;
+	b->min_cursor = 0;
+	b->head = 0;
+	b->tail = 0;
+	b->num_blocked = 0;
+	b->producer_blocked = 0;
+	for(size = 0; size < max_subs; ++size){
+		b->subs[size].bcast = b;
+		b->subs[size].lwt = NULL;
+		b->subs[size].is_active = 0;
+		b->subs[size].cursor = 0;
+		b->subs[size].is_blocked = 0;
+		b->subs[size].num_dropped = 0;
+	}
+	return b;
+}
+
+/**
+ * @brief Frees the broadcast channel
+ * @param b The broadcast channel
+ * @return 0 if successful; -1 if it still has subscribers
+ */
+int lwt_bcast_free(lwt_bcast_t b){
+	unsigned int index;
+	assert(b->producer == lwt_current());
+	for(index = 0; index < b->max_subs; ++index){
+		if(b->subs[index].is_active){
+			return -1;
+		}
+	}
+	lwt_free((void *)b->slots);
+	free(b->subs);
+	free(b);
+	return 0;
+}
+
+/**
+ * @brief Subscribes the current lwt, on any kthd, to the broadcast channel
+ * @param b The broadcast channel
+ * @return The subscription; NULL if all of the subscriber slots are taken
+ * @note Only messages sent after subscribing are received
+ */
+lwt_bcast_sub_t lwt_bcast_sub(lwt_bcast_t b){
+	unsigned int index;
+	lwt_bcast_sub_t sub;
+	for(index = 0; index < b->max_subs; ++index){
+		sub = &b->subs[index];
+		if(!sub->is_active && !__cas(&sub->is_active, 0, 1)){
+			sub->lwt = lwt_current();
+			sub->is_blocked = 0;
+			sub->num_dropped = 0;
+			sub->cursor = b->head;
+			//a producer parked on the previous owner of the slot has to rescan
+			__mem_barrier();
+			__bcast_wake_producer(b);
+			return sub;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Drops the subscription; unreceived messages are skipped
+ * @param sub The subscription
+ */
+void lwt_bcast_unsub(lwt_bcast_sub_t sub){
+	lwt_bcast_t b = sub->bcast;
+	assert(sub->lwt == lwt_current());
+	sub->lwt = NULL;
+	sub->is_active = 0;
+	__mem_barrier();
+	__bcast_wake_producer(b);
+}
+
+/**
+ * @brief Sends the messages to every subscriber
+ * @param b The broadcast channel
+ * @param data The messages
+ * @param n The number of messages
+ * @return 0 if successful
+ * @note Parked subscribers are woken once for the whole batch
+ */
+int lwt_bcast_snd_n(lwt_bcast_t b, void ** data, unsigned int n){
+	unsigned int index;
+	unsigned long seq;
+	assert(b->producer == lwt_current());
+	for(index = 0; index < n; ++index){
+		if(b->policy == LWT_BCAST_BLOCK){
+			__bcast_wait_room(b);
+		}
+		seq = b->head;
+		//claim the slot before overwriting it; subscribers check the tail after reading
+		b->tail = seq + 1;
+		__compiler_barrier();
+		b->slots[seq & b->mask] = data[index];
+		__compiler_barrier();
+		b->head = seq + 1;
+	}
+	__bcast_wake_subs(b);
+	return 0;
+}
+
+/**
+ * @brief Sends the message to every subscriber
+ * @param b The broadcast channel
+ * @param data The message
+ * @return 0 if successful
+ */
+int lwt_bcast_snd(lwt_bcast_t b, void * data){
+	return lwt_bcast_snd_n(b, &data, 1);
+}
+
+/**
+ * @brief Receives the next message of the subscription; blocks until there is one
+ * @param sub The subscription
+ * @return The message
+ */
+void * lwt_bcast_rcv(lwt_bcast_sub_t sub){
+	lwt_bcast_t b = sub->bcast;
+	void * data;
+	assert(sub->lwt == lwt_current());
+	while(__bcast_take(sub, &data)){
+		sub->is_blocked = 1;
+		//publishes is_blocked before rechecking the head
+		fetch_and_add(&b->num_blocked, 1);
+		if(sub->cursor != b->head){
+			if(!__cas(&sub->is_blocked, 1, 0)){
+				fetch_and_add(&b->num_blocked, -1);
+				continue;
+			}
+		}
+		lwt_block(LWT_INFO_NRECEIVING);
+	}
+	return data;
+}
+
+/**
+ * @brief Receives the next message of the subscription without blocking
+ * @param sub The subscription
+ * @param data Set to the message
+ * @return 0 if a message was received; -1 if the subscriber is caught up
+ */
+int lwt_bcast_rcv_try(lwt_bcast_sub_t sub, void ** data){
+	assert(sub->lwt == lwt_current());
+	return __bcast_take(sub, data);
+}
+
+/**
+ * @brief Gets the number of messages the subscriber missed because the producer overwrote them
+ * @param sub The subscription
+ * @return The number of dropped messages
+ */
+unsigned int lwt_bcast_dropped(lwt_bcast_sub_t sub){
+	return sub->num_dropped;
+}
@@ -0,0 +1,23 @@
+/*
+ * lwt_bcast.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_BCAST_H_
+#define LWT_BCAST_H_
+
+#include "objects.h"
+
+lwt_bcast_t lwt_chan_bcast(unsigned int, unsigned int, lwt_bcast_policy_t);
+int lwt_bcast_free(lwt_bcast_t);
+lwt_bcast_sub_t lwt_bcast_sub(lwt_bcast_t);
+void lwt_bcast_unsub(lwt_bcast_sub_t);
+int lwt_bcast_snd(lwt_bcast_t, void *);
+int lwt_bcast_snd_n(lwt_bcast_t, void **, unsigned int);
+void * lwt_bcast_rcv(lwt_bcast_sub_t);
+int lwt_bcast_rcv_try(lwt_bcast_sub_t, void **);
+unsigned int lwt_bcast_dropped(lwt_bcast_sub_t);
+
+#endif /* LWT_BCAST_H_ */
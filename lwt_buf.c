@@ -0,0 +1,218 @@
+/*
+ * lwt_buf.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_buf.h"
+#include "lwt.h"
+#include "lwt_chan.h"
+#include "lwt_kthd.h"
+
+#include "objects.h"
+
+#include "stdlib.h"
+#include "assert.h"
+#include "faa.h"
+#include "cas.h"
+
+/**
+ * @brief Creates a pool of buffers owned by the current kthd
+ * @param buf_size The size of each buffer
+ * @param num_bufs The number of buffers
+ * @return The pool; NULL if it couldn't be allocated
+ */
+lwt_buf_pool_t lwt_buf_pool(unsigned int buf_size, unsigned int num_bufs){
+	void * mem;
+	lwt_buf_pool_t pool;
+	unsigned int index;
+	assert(buf_size > 0 && num_bufs > 0);
+	if(posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(struct lwt_buf_pool))){
+		return NULL;
+	}
+	pool = (lwt_buf_pool_t)mem;
+	pool->bufs = (struct lwt_buf *)malloc(num_bufs * sizeof(struct lwt_buf));
+	pool->memory = (char *)malloc((size_t)num_bufs * buf_size);
+	if(!pool->bufs || !pool->memory){
+		free(pool->bufs);
+		free(pool->memory);
+		free(pool);
+		return NULL;
+	}
+	pool->kthd = __get_kthd();
+	pool->buf_size = buf_size;
+	pool->num_bufs = num_bufs;
+	pool->remote_free = 0;
+	pool->free_bufs = NULL;
+	TAILQ_INIT(&pool->head_blocked_allocs);
+	pool->is_blocked = 0;
+	pool->num_remote_releasing = 0;
+	for(index = 0; index < num_bufs; ++index){
+		pool->bufs[index].pool = pool;
+		pool->bufs[index].data = pool->memory + (size_t)index * buf_size;
+		pool->bufs[index].size = buf_size;
+		pool->bufs[index].len = 0;
+		pool->bufs[index].ref_cnt = 0;
+		pool->bufs[index].next = pool->free_bufs;
+		pool->free_bufs = &pool->bufs[index];
+	}
+	return pool;
+}
+
+/**
+ * @brief Frees the pool and all of its buffers
+ * @param pool The pool to free
+ * @return 0 if successful; -1 if a buffer is still lent out
+ * @note Waits for releases on other kthds that dropped their last reference but still use the pool
+ */
+int lwt_buf_pool_free(lwt_buf_pool_t pool){
+	unsigned int index;
+	assert(pool->kthd == __get_kthd());
+	assert(!pool->head_blocked_allocs.tqh_first);
+	for(index = 0; index < pool->num_bufs; ++index){
+		if(pool->bufs[index].ref_cnt){
+			return -1;
+		}
+	}
+	//a release counts itself in before it drops its reference, so none can start from here on
+	while(pool->num_remote_releasing){
+		lwt_yield(LWT_NULL);
+	}
+	free(pool->bufs);
+	free(pool->memory);
+	free(pool);
+	return 0;
+}
+
+/**
+ * @brief Takes a free buffer from the pool; must be called on the kthd owning the pool
+ * @param pool The pool to allocate from
+ * @return The buffer, holding the caller's reference
+ * @note Parks until a buffer is released if all of them are lent out; parked lwts get buffers in order
+ */
+lwt_buf_t lwt_buf_alloc(lwt_buf_pool_t pool){
+	lwt_buf_t buf;
+	lwt_t current = lwt_current();
+	int is_queued = 0;
+	assert(pool->kthd == __get_kthd());
+	while(!pool->free_bufs){
+		//take everything released on other kthds at once
+		if(pool->remote_free){
+			pool->free_bufs = (lwt_buf_t)__xchg(&pool->remote_free, 0);
+			continue;
+		}
+		if(!is_queued){
+			TAILQ_INSERT_TAIL(&pool->head_blocked_allocs, current, blocked_senders);
+			is_queued = 1;
+		}
+		//a release on another kthd looks at the flag after its push; look again after it can see us
+		pool->is_blocked = 1;
+		__mem_barrier();
+		if(pool->remote_free){
+			continue;
+		}
+		lwt_block(LWT_INFO_NTHD_BLOCKED);
+	}
+	buf = pool->free_bufs;
+	pool->free_bufs = buf->next;
+	if(is_queued){
+		TAILQ_REMOVE(&pool->head_blocked_allocs, current, blocked_senders);
+		if(pool->head_blocked_allocs.tqh_first){
+			//the release that woke us may have been meant for the next one
+			pool->is_blocked = 1;
+			__mem_barrier();
+			if(pool->free_bufs || pool->remote_free){
+				lwt_signal(pool->head_blocked_allocs.tqh_first);
+			}
+		}
+		else{
+			pool->is_blocked = 0;
+		}
+	}
+	buf->next = NULL;
+	buf->len = 0;
+	buf->ref_cnt = 1;
+	return buf;
+}
+
+/**
+ * @brief Takes another reference to the buffer; e.g. before lending it to a second receiver
+ * @param buf The buffer
+ */
+void lwt_buf_ref(lwt_buf_t buf){
+	assert(buf->ref_cnt > 0);
+	fetch_and_add((volatile unsigned int *)&buf->ref_cnt, 1);
+}
+
+/**
+ * @brief Drops a reference to the buffer; the last one hands it back to the pool of the owning kthd
+ * @param buf The buffer
+ */
+void lwt_buf_release(lwt_buf_t buf){
+	lwt_buf_pool_t pool = buf->pool;
+	unsigned long head;
+	assert(buf->ref_cnt > 0);
+	if(pool->kthd == __get_kthd()){
+		if(fetch_and_add((volatile unsigned int *)&buf->ref_cnt, -1) != 1){
+			return;
+		}
+		buf->next = pool->free_bufs;
+		pool->free_bufs = buf;
+		if(pool->head_blocked_allocs.tqh_first){
+			lwt_signal(pool->head_blocked_allocs.tqh_first);
+		}
+		return;
+	}
+	//our reference keeps the pool alive until here; the count keeps it alive past the last one
+	fetch_and_add(&pool->num_remote_releasing, 1);
+	if(fetch_and_add((volatile unsigned int *)&buf->ref_cnt, -1) != 1){
+		fetch_and_add(&pool->num_remote_releasing, -1);
+		return;
+	}
+	//only pushes race here; the owner takes the whole stack, so there's no ABA to worry about
+	do{
+		head = pool->remote_free;
+		buf->next = (lwt_buf_t)head;
+	}while(__cas(&pool->remote_free, head, (unsigned long)buf));
+	//the buffer must be visible before we look at the flag; the same order as the allocator's
+	__mem_barrier();
+	if(pool->is_blocked && __xchg(&pool->is_blocked, 0)){
+		//the parked lwts belong to the owner; it picks the one to wake and lets go of the pool for us
+		__init_kthd_buf_pool_event(pool);
+		return;
+	}
+	fetch_and_add(&pool->num_remote_releasing, -1);
+}
+
+/**
+ * @brief Handles a wake posted by a release on another kthd; called on the kthd owning the pool
+ * @param pool The pool
+ * @return The lwt to wake; NULL if nobody is parked on the pool anymore
+ */
+lwt_t __buf_pool_wake(lwt_buf_pool_t pool){
+	lwt_t waiter = pool->head_blocked_allocs.tqh_first;
+	//the pool may be freed as soon as the count drops
+	fetch_and_add(&pool->num_remote_releasing, -1);
+	return waiter;
+}
+
+/**
+ * @brief Lends the buffer over the channel; the caller's reference moves to the receiver
+ * @param c The channel to send the buffer over
+ * @param buf The buffer to lend
+ * @return -1 if there is no receiver; 0 if successful
+ * @note Take another reference with lwt_buf_ref first to keep using the buffer
+ */
+int lwt_snd_buf(lwt_chan_t c, lwt_buf_t buf){
+	assert(buf->ref_cnt > 0);
+	return lwt_snd(c, buf);
+}
+
+/**
+ * @brief Receives a lent buffer over the channel
+ * @param c The channel to receive from
+ * @return The buffer; the receiver owns the reference and must release it with lwt_buf_release
+ */
+lwt_buf_t lwt_rcv_buf(lwt_chan_t c){
+	return (lwt_buf_t)lwt_rcv(c);
+}
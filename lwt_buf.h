@@ -0,0 +1,24 @@
+/*
+ * lwt_buf.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_BUF_H_
+#define LWT_BUF_H_
+
+#include "objects.h"
+
+lwt_buf_pool_t lwt_buf_pool(unsigned int, unsigned int);
+int lwt_buf_pool_free(lwt_buf_pool_t);
+lwt_buf_t lwt_buf_alloc(lwt_buf_pool_t);
+void lwt_buf_ref(lwt_buf_t);
+void lwt_buf_release(lwt_buf_t);
+int lwt_snd_buf(lwt_chan_t, lwt_buf_t);
+lwt_buf_t lwt_rcv_buf(lwt_chan_t);
+
+//package functions
+lwt_t __buf_pool_wake(lwt_buf_pool_t);
+
+#endif /* LWT_BUF_H_ */
@@ -0,0 +1,71 @@
+/*
+ * lwt_call.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_call.h"
+#include "lwt.h"
+#include "lwt_chan.h"
+
+#include "objects.h"
+
+#include "assert.h"
+#include "cas.h"
+
+/**
+ * @brief Sends the request to the server and parks until it replies
+ * @param c The channel the server receives calls on
+ * @param request The request
+ * @return The reply; NULL if the channel has no receiver
+ * @note The reply slot lives in the caller, so a call costs one send and one wakeup each way
+ */
+void * lwt_call(lwt_chan_t c, void * request){
+	lwt_t current = lwt_current();
+	struct lwt_call * call = &current->call;
+	call->caller = current;
+	call->request = request;
+	call->reply = NULL;
+	call->is_replied = 0;
+	if(lwt_snd(c, call)){
+		return NULL;
+	}
+	//the server may have replied while the send was parked; the flag is set before the wakeup
+	while(!call->is_replied){
+		lwt_block(LWT_INFO_NRECEIVING);
+	}
+	return call->reply;
+}
+
+/**
+ * @brief Receives the next call on the channel
+ * @param c The channel callers send to
+ * @return The call; answer it with lwt_reply
+ */
+lwt_call_t lwt_rcv_call(lwt_chan_t c){
+	return (lwt_call_t)lwt_rcv(c);
+}
+
+/**
+ * @brief Gets the request of the call
+ * @param call The call
+ * @return The request
+ */
+void * lwt_call_req(lwt_call_t call){
+	return call->request;
+}
+
+/**
+ * @brief Replies to the call and wakes the caller; the call must not be touched afterwards
+ * @param call The call
+ * @param reply The reply handed back by lwt_call
+ */
+void lwt_reply(lwt_call_t call, void * reply){
+	lwt_t caller = call->caller;
+	assert(!call->is_replied);
+	call->reply = reply;
+	__compiler_barrier();
+	call->is_replied = 1;
+	//on the same kthd, the caller runs as soon as we block or yield
+	__lwt_signal_next(caller);
+}
@@ -0,0 +1,18 @@
+/*
+ * lwt_call.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_CALL_H_
+#define LWT_CALL_H_
+
+#include "objects.h"
+
+void * lwt_call(lwt_chan_t, void *);
+lwt_call_t lwt_rcv_call(lwt_chan_t);
+void * lwt_call_req(lwt_call_t);
+void lwt_reply(lwt_call_t, void *);
+
+#endif /* LWT_CALL_H_ */
@@ -8,34 +8,52 @@
 #include "lwt_cgrp.h"
 #include "lwt.h"
 #include "lwt_chan.h"
+#include "lwt_kthd.h"
+#include "lwt_chan_stats.h"
+#include "lwt_slab.h"
+#include "cas.h"
 
 #include "stdlib.h"
 #include "assert.h"
 #include "stdio.h"
+#include "unistd.h"
 #include "sys/queue.h"
+#include "sys/epoll.h"
+#include "sys/timerfd.h"
 
 
 
 /**
  * @brief Initializes the event for when data is added to the channel
  * @param channel The channel with the new data
- * @param sender The sender lwt
+ * @note Does nothing if the channel already has an event queued
  */
 void __init_event(lwt_chan_t channel){
-	if(channel->channel_group && channel->num_entries == 1){
+	if(channel->channel_group && !channel->event_queued && !__xchg(&channel->event_queued, 1)){
 		//printf("Inserting event for channel: %d\n", (int)channel);
 		//printf("Num entries: %d\n", channel->num_entries);
 		//printf("Channel already has been added: %d\n", channel->events.tqe_next);
-		if(__get_kthd() == channel->channel_group->creator_thread->kthd){
-			TAILQ_INSERT_TAIL(&channel->channel_group->head_event, channel, events);
-		}
-		else{
-			__init_kthd_event(NULL, channel, channel->channel_group, channel->channel_group->creator_thread->kthd, LWT_REMOTE_ADD_EVENT_TO_GROUP, 1);
-		}
-		if(channel->channel_group->waiting_thread){
-			lwt_signal(channel->channel_group->waiting_thread);
+		__stats_event(channel);
+		__insert_event(channel, channel->channel_group);
+	}
+}
+
+/**
+ * @brief Queues the event of the channel on the group and wakes the waiting lwt
+ * @param channel The channel with the new data
+ * @param group The group of the channel
+ */
+void __insert_event(lwt_chan_t channel, lwt_cgrp_t group){
+	if(__get_kthd() == group->creator_thread->kthd){
+		TAILQ_INSERT_TAIL(&group->head_event, channel, events);
+		if(group->waiting_thread){
+			lwt_signal(group->waiting_thread);
 		}
 	}
+	else{
+		//the waiting lwt is woken by the group's kthd once the event is actually queued
+		__init_kthd_event(NULL, channel, group, group->creator_thread->kthd, LWT_REMOTE_ADD_EVENT_TO_GROUP, 0);
+	}
 }
 
 /**
@@ -46,6 +64,7 @@ void __init_event(lwt_chan_t channel){
 void __remove_event(lwt_chan_t channel, lwt_cgrp_t group){
 	if(__get_kthd() == group->creator_thread->kthd){
 		TAILQ_REMOVE(&group->head_event, channel, events);
+		channel->event_queued = 0;
 	}
 	else{
 		__init_kthd_event(NULL, channel, channel->channel_group, channel->channel_group->creator_thread->kthd, LWT_REMOTE_REMOVE_EVENT_FROM_GROUP, 1);
@@ -59,7 +78,7 @@ void __remove_event(lwt_chan_t channel, lwt_cgrp_t group){
  * @note By default, the group is empty
  */
 lwt_cgrp_t lwt_cgrp(){
-	lwt_cgrp_t group = (lwt_cgrp_t)malloc(sizeof(struct lwt_cgrp));
+	lwt_cgrp_t group = (lwt_cgrp_t)__slab_alloc(LWT_SLAB_CGRP);
 	if(!group){
 		return LWT_NULL;
 	}
@@ -67,9 +86,109 @@ lwt_cgrp_t lwt_cgrp(){
 	TAILQ_INIT(&group->head_event);
 	group->waiting_thread = NULL;
 	group->creator_thread = lwt_current();
+	group->trigger = LWT_CGRP_EDGE;
 	return group;
 }
 
+/**
+ * @brief Sets when the group reports its channels as ready
+ * @param group The group to set
+ * @param trigger LWT_CGRP_EDGE to report a channel once per arrival; LWT_CGRP_LEVEL to keep reporting
+ * it while it has data
+ * @return 0 if successful; -1 if the group has pending events
+ */
+int lwt_cgrp_trigger(lwt_cgrp_t group, lwt_cgrp_trigger_t trigger){
+	assert(__get_kthd() == group->creator_thread->kthd);
+	if(group->head_event.tqh_first){
+		return -1;
+	}
+	group->trigger = trigger;
+	return 0;
+}
+
+/**
+ * @brief Checks if the channel has data to receive
+ * @param channel The channel to check
+ * @return 1 if a receive wouldn't block; 0 otherwise
+ */
+static int __chan_ready(lwt_chan_t channel){
+	if(channel->buffer_size > 0){
+		return __chan_num_entries(channel) > 0;
+	}
+	return channel->head_blocked_senders.tqh_first != NULL;
+}
+
+/**
+ * @brief Drops the event of a drained channel from a level-triggered group
+ * @param channel The channel to drop
+ * @param group The group of the channel
+ * @note Raises the event again if data arrived while it was dropped
+ */
+static void __drop_event(lwt_chan_t channel, lwt_cgrp_t group){
+	__remove_event(channel, group);
+	//a sender that saw the event still queued didn't raise it again
+	__mem_barrier();
+	if(__chan_ready(channel)){
+		__init_event(channel);
+	}
+}
+
+/**
+ * @brief Drops the events of drained channels from a level-triggered group
+ * @param group The group to check
+ */
+static void __drop_stale_events(lwt_cgrp_t group){
+	lwt_chan_t channel, next;
+	if(group->trigger != LWT_CGRP_LEVEL){
+		return;
+	}
+	for(channel = group->head_event.tqh_first; channel; channel = next){
+		next = channel->events.tqe_next;
+		if(!__chan_ready(channel)){
+			__drop_event(channel, group);
+		}
+	}
+}
+
+/**
+ * @brief Takes up to max ready channels off the group's event queue without blocking
+ * @param group The group to check
+ * @param channels Where to store the ready channels
+ * @param max The maximum number of channels to take
+ * @return The number of channels stored
+ */
+static int __collect_events(lwt_cgrp_t group, lwt_chan_t * channels, int max){
+	lwt_chan_t channel, next;
+	int count = 0, num_events = 0;
+	if(group->trigger == LWT_CGRP_EDGE){
+		for(channel = group->head_event.tqh_first; channel && count < max; channel = next){
+			next = channel->events.tqe_next;
+			channels[count++] = channel;
+			//leave the event queued if one receive won't drain the channel
+			if(__chan_num_entries(channel) <= 1){
+				__remove_event(channel, group);
+			}
+		}
+		return count;
+	}
+	for(channel = group->head_event.tqh_first; channel; channel = channel->events.tqe_next){
+		num_events++;
+	}
+	//ready channels go to the back, so a busy channel can't starve the others
+	while(num_events-- > 0 && count < max){
+		channel = group->head_event.tqh_first;
+		if(__chan_ready(channel)){
+			TAILQ_REMOVE(&group->head_event, channel, events);
+			TAILQ_INSERT_TAIL(&group->head_event, channel, events);
+			channels[count++] = channel;
+		}
+		else{
+			__drop_event(channel, group);
+		}
+	}
+	return count;
+}
+
 
 
 /**
@@ -78,6 +197,7 @@ lwt_cgrp_t lwt_cgrp(){
  * @return 0 if successful; -1 if there are pending events
  */
 int lwt_cgrp_free(lwt_cgrp_t group){
+	__drop_stale_events(group);
 	if(group->head_event.tqh_first){
 		//perror("There is still an event to consume\n");
 		return -1;
@@ -86,7 +206,7 @@ int lwt_cgrp_free(lwt_cgrp_t group){
 	while(group->head_channels_in_group.lh_first){
 		LIST_REMOVE(group->head_channels_in_group.lh_first, channels_in_group);
 	}
-	free(group);
+	__slab_free(LWT_SLAB_CGRP, group);
 	return 0;
 }
 
@@ -94,20 +214,104 @@ int lwt_cgrp_free(lwt_cgrp_t group){
  * @brief Adds the channel to the group if the channel hasn't already been added to a group
  * @param group The group to add the channel to
  * @param channel The channel to add
- * @return 0 if successful; -1 if the channel is already part of a group
+ * @return 0 if successful; -1 if the channel is already part of a group or has several receivers
  */
 int lwt_cgrp_add(lwt_cgrp_t group, lwt_chan_t channel){
-	if(channel->channel_group){
+	if(channel->channel_group || channel->type == LWT_CHAN_MPMC){
 		return -1;
 	}
+	//set up front so that events raised before the remote insert are still routed to the group
+	channel->channel_group = group;
+	__insert_channel_to_group(group, channel);
+	//senders only raise the event on the empty to non-empty edge, which may have come before the group
+	__mem_barrier();
+	if(channel->buffer_size > 0 && __chan_num_entries(channel)){
+		__init_event(channel);
+	}
+	return 0;
+}
+
+/**
+ * @brief Adds a descriptor to the group; the kthd pushes its epoll events into a channel that joins the group
+ * @param group The group to add the descriptor to; must be on the current kthd
+ * @param fd The descriptor to watch; stays owned by the caller
+ * @param events The epoll events to watch for (e.g. EPOLLIN)
+ * @return The channel reporting the descriptor, received by the current lwt; NULL if the descriptor
+ * couldn't be watched
+ * @note The descriptor is edge-triggered: each receive on the channel gives the events that fired, and the
+ * descriptor should then be read or written until EAGAIN. Edges firing while a readiness is still pending are
+ * folded into it. Removing and dereferencing the channel stops the watch
+ */
+lwt_chan_t lwt_cgrp_add_fd(lwt_cgrp_t group, int fd, unsigned int events){
+	lwt_chan_t channel;
+	assert(__get_kthd() == group->creator_thread->kthd);
+	//the kthd holds back readiness while one is pending, so the smallest buffer will do
+	channel = lwt_chan(1);
+	if(__kthd_watch(channel, fd, events, 0)){
+		lwt_chan_deref(channel);
+		return LWT_NULL;
+	}
+	lwt_cgrp_add(group, channel);
+	return channel;
+}
+
+/**
+ * @brief Adds a deadline to the group; a channel that joins the group receives once it has passed
+ * @param group The group to add the deadline to; must be on the current kthd
+ * @param ns The time from now until the deadline in nanoseconds
+ * @return The channel reporting the deadline, received by the current lwt; NULL if the timer couldn't be created
+ * @note The channel receives the number of expirations, i.e. 1. Removing and dereferencing the channel
+ * cancels the deadline if it hasn't passed yet
+ */
+lwt_chan_t lwt_cgrp_add_timer(lwt_cgrp_t group, unsigned long long ns){
+	lwt_chan_t channel;
+	assert(__get_kthd() == group->creator_thread->kthd);
+	channel = __timer_chan(ns);
+	if(!channel){
+		return LWT_NULL;
+	}
+	lwt_cgrp_add(group, channel);
+	return channel;
+}
+
+/**
+ * @brief Creates a channel that receives once, when the deadline has passed
+ * @param ns The time from now until the deadline in nanoseconds
+ * @return The channel, received by the current lwt; NULL if the timer couldn't be created
+ * @note The timerfd is watched by the current kthd; dereferencing the channel cancels the deadline
+ */
+lwt_chan_t __timer_chan(unsigned long long ns){
+	lwt_chan_t channel;
+	struct itimerspec deadline = {{0, 0}, {0, 0}};
+	int fd;
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(fd < 0){
+		return LWT_NULL;
+	}
+	//a zero value would disarm the timer instead of firing it right away
+	deadline.it_value.tv_sec = ns / 1000000000ULL;
+	deadline.it_value.tv_nsec = ns ? ns % 1000000000ULL : 1;
+	channel = lwt_chan(1);
+	if(timerfd_settime(fd, 0, &deadline, NULL) || __kthd_watch(channel, fd, EPOLLIN, 1)){
+		close(fd);
+		lwt_chan_deref(channel);
+		return LWT_NULL;
+	}
+	return channel;
+}
+
+/**
+ * @brief Links the channel into the group's list of channels
+ * @param group The group to add the channel to
+ * @param channel The channel to add
+ */
+void __insert_channel_to_group(lwt_cgrp_t group, lwt_chan_t channel){
 	if(__get_kthd() == group->creator_thread->kthd){
-		channel->channel_group = group;
 		LIST_INSERT_HEAD(&group->head_channels_in_group, channel, channels_in_group);
 	}
 	else{
-		__init_kthd_event(NULL, channel, group, group->creator_thread->kthd, LWT_REMOTE_ADD_CHANNEL_TO_GROUP, 1);
+		__init_kthd_event(NULL, channel, group, group->creator_thread->kthd, LWT_REMOTE_ADD_CHANNEL_TO_GROUP, 0);
 	}
-	return 0;
 }
 
 /**
@@ -121,6 +325,9 @@ int lwt_cgrp_rem(lwt_cgrp_t group, lwt_chan_t channel){
 		//printf("Assigned group is not provided channel\n");
 		return -1;
 	}
+	if(__get_kthd() == group->creator_thread->kthd){
+		__drop_stale_events(group);
+	}
 	if(group->head_event.tqh_first){
 		//printf("Event queue is not empty\n");
 		return 1;
@@ -139,19 +346,36 @@ int lwt_cgrp_rem(lwt_cgrp_t group, lwt_chan_t channel){
  * @return The event in the queue
  */
 lwt_chan_t lwt_cgrp_wait(lwt_cgrp_t group){
+	lwt_chan_t channel;
+	lwt_cgrp_wait_n(group, &channel, 1);
+	//printf("Received channel: %d with num entries: %d\n", (int)channel, channel->num_entries);
+	return channel;
+}
+
+/**
+ * @brief Waits until there is a pending event in the queue, then takes all of the ready channels at once
+ * @param group The group to wait for
+ * @param channels Where to store the ready channels
+ * @param max The maximum number of channels to take
+ * @return The number of channels stored; at least 1
+ * @note Level-triggered groups keep reporting a channel until it's drained, so a multiplexer can empty
+ * each returned channel with lwt_rcv_try and come back for the next batch
+ */
+int lwt_cgrp_wait_n(lwt_cgrp_t group, lwt_chan_t * channels, int max){
+	int count = 0;
+	assert(max > 0);
 	group->waiting_thread = lwt_current();
-	//wait until there is an event in the queue
-	while(!group->head_event.tqh_first){
-		//printf("Waiting for new event in lwt: %d\n", lwt_current()->id);
-		lwt_block(LWT_INFO_NRECEIVING);
+	while(!count){
+		//wait until there is an event in the queue
+		while(!group->head_event.tqh_first){
+			//printf("Waiting for new event in lwt: %d\n", lwt_current()->id);
+			lwt_block(LWT_INFO_NRECEIVING);
+		}
+		//every event may have been stale
+		count = __collect_events(group, channels, max);
 	}
 	group->waiting_thread = NULL;
-	lwt_chan_t channel = group->head_event.tqh_first;
-	if(channel->num_entries == 1){
-		__remove_event(channel, group);
-	}
-	//printf("Received channel: %d with num entries: %d\n", (int)channel, channel->num_entries);
-	return channel;
+	return count;
 }
 
 /**
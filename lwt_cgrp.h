@@ -14,12 +14,19 @@ lwt_cgrp_t lwt_cgrp();
 int lwt_cgrp_free(lwt_cgrp_t);
 int lwt_cgrp_add(lwt_cgrp_t, lwt_chan_t);
 int lwt_cgrp_rem(lwt_cgrp_t, lwt_chan_t);
+lwt_chan_t lwt_cgrp_add_fd(lwt_cgrp_t, int, unsigned int);
+lwt_chan_t lwt_cgrp_add_timer(lwt_cgrp_t, unsigned long long);
 lwt_chan_t lwt_cgrp_wait(lwt_cgrp_t);
+int lwt_cgrp_wait_n(lwt_cgrp_t, lwt_chan_t *, int);
+int lwt_cgrp_trigger(lwt_cgrp_t, lwt_cgrp_trigger_t);
 void lwt_chan_mark_set(lwt_chan_t, void *);
 void * lwt_chan_mark_get(lwt_chan_t);
 
 //private functions
 void __init_event(lwt_chan_t);
+void __insert_event(lwt_chan_t, lwt_cgrp_t);
+void __insert_channel_to_group(lwt_cgrp_t, lwt_chan_t);
 void __remove_event(lwt_chan_t, lwt_cgrp_t);
+lwt_chan_t __timer_chan(unsigned long long);
 
 #endif /* LWT_CGRP_H_ */
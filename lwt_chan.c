@@ -8,6 +8,9 @@
 #include "lwt.h"
 #include "lwt_cgrp.h"
 #include "lwt_kthd.h"
+#include "lwt_ring.h"
+#include "lwt_chan_stats.h"
+#include "lwt_slab.h"
 
 #include "objects.h"
 
@@ -15,34 +18,61 @@
 #include "stdlib.h"
 #include "assert.h"
 #include "faa.h"
+#include "cas.h"
+
+static lwt_chan_t __init_chan(int, lwt_chan_type_t, unsigned int);
+static inline void __notify_receiver(lwt_chan_t);
+static void __release_chan(lwt_chan_t);
+
+/**
+ * @brief Left in the handoff slot of a synchronous channel while its receiver is parked; its address is the token
+ */
+static char rcv_parked;
+
+/**
+ * Token telling a try-send that the receiver is parked on the channel with nothing handed over
+ */
+#define RCV_PARKED ((void *)&rcv_parked)
 
 /**
- * @brief Inserts the sender into the channel
- * @param chan The channel to insert the sender
+ * @brief Gives the lwt sender rights on the channel
+ * @param chan The channel
  * @param lwt The sender lwt
+ * @note Only counts; nothing is linked, so this is safe from any kthd without involving the owning one
  */
 void __insert_sender_to_chan(lwt_chan_t chan, lwt_t lwt){
-	if(__get_kthd() == chan->kthd){
-		LIST_INSERT_HEAD(&chan->head_senders, lwt, senders);
-		chan->snd_cnt++;
-	}
-	else{
-		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_ADD_SENDER_TO_CHANNEL, 1);
+	if(!lwt || lwt->kthd != chan->kthd){
+		chan->is_shared = 1;
 	}
+	fetch_and_add((volatile unsigned int *)&chan->snd_cnt, 1);
+	fetch_and_add((volatile unsigned int *)&chan->ref_cnt, 1);
 }
 
 /**
- * @brief Removes the sender from the channel
- * @param chan The channel to remove the sender from
- * @param lwt The sender to remove
+ * @brief Drops the sender rights of the current lwt on the channel
+ * @param chan The channel
  */
-void __remove_sender_from_chan(lwt_chan_t chan, lwt_t lwt){
-	if(__get_kthd() == chan->kthd){
-		LIST_REMOVE(lwt, senders);
-		chan->snd_cnt--;
+void __remove_sender_from_chan(lwt_chan_t chan){
+	assert(chan->snd_cnt > 0);
+	fetch_and_add((volatile unsigned int *)&chan->snd_cnt, -1);
+	__release_chan(chan);
+}
+
+/**
+ * @brief Drops a reference to the channel; whoever drops the last one has it freed
+ * @param chan The channel
+ */
+static void __release_chan(lwt_chan_t chan){
+	if(fetch_and_add((volatile unsigned int *)&chan->ref_cnt, -1) != 1){
+		return;
+	}
+	if(chan->is_shared){
+		//lwts on other kthds may have pushed events naming the channel before letting go; those are
+		//ahead of this one on the owning kthd's ring
+		__init_kthd_event(lwt_current(), chan, NULL, chan->kthd, LWT_REMOTE_FREE_CHANNEL, 0);
 	}
 	else{
-		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_REMOVE_SENDER_FROM_CHANNEL, 1);
+		__free_chan(chan);
 	}
 }
 
@@ -54,9 +84,12 @@ void __remove_sender_from_chan(lwt_chan_t chan, lwt_t lwt){
 void __insert_blocked_sender_to_chan(lwt_chan_t chan, lwt_t lwt){
 	if(__get_kthd() == chan->kthd){
 		TAILQ_INSERT_TAIL(&chan->head_blocked_senders, lwt, blocked_senders);
+		lwt->is_blocked_sender = 1;
 	}
 	else{
-		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_ADD_BLOCKED_SENDER_TO_CHANNEL, 1);
+		//the sender is about to block anyway; the owning kthd wakes whoever is waiting on the insert
+		lwt->is_blocked_sender = 1;
+		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_ADD_BLOCKED_SENDER_TO_CHANNEL, 0);
 	}
 }
 
@@ -64,10 +97,14 @@ void __insert_blocked_sender_to_chan(lwt_chan_t chan, lwt_t lwt){
  * @brief Removes the sender from the channel's blocked queue
  * @param chan The channel owning the queue
  * @param lwt The sender to remove from the queue
+ * @note Does nothing if the sender has already been removed
  */
 void __remove_blocked_sender_from_chan(lwt_chan_t chan, lwt_t lwt){
 	if(__get_kthd() == chan->kthd){
-		TAILQ_REMOVE(&chan->head_blocked_senders, lwt, blocked_senders);
+		if(lwt->is_blocked_sender){
+			TAILQ_REMOVE(&chan->head_blocked_senders, lwt, blocked_senders);
+			lwt->is_blocked_sender = 0;
+		}
 	}
 	else{
 		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_REMOVE_BLOCKED_SENDER_FROM_CHANNEL, 1);
@@ -75,28 +112,542 @@ void __remove_blocked_sender_from_chan(lwt_chan_t chan, lwt_t lwt){
 }
 
 /**
- * @brief Pushes the data into the buffer
- * @param c The channel to add the data to
- * @param data The data to add
+ * @brief Parks the receiver on a multi-consumer channel until it has data
+ * @param chan The channel owning the queue
+ * @param lwt The receiver to add to the queue
+ */
+void __insert_blocked_receiver_to_chan(lwt_chan_t chan, lwt_t lwt){
+	lwt->is_blocked_receiver = 1;
+	if(__get_kthd() == chan->kthd){
+		TAILQ_INSERT_TAIL(&chan->head_blocked_receivers, lwt, blocked_receivers);
+	}
+	else{
+		//the owning kthd wakes the receiver right away if data came in before the insert
+		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_ADD_BLOCKED_RECEIVER_TO_CHANNEL, 0);
+	}
+}
+
+/**
+ * @brief Removes the receiver from the channel's blocked receivers queue
+ * @param chan The channel owning the queue
+ * @param lwt The receiver to remove from the queue
+ * @note Does nothing if the receiver has already been removed
+ */
+void __remove_blocked_receiver_from_chan(lwt_chan_t chan, lwt_t lwt){
+	if(__get_kthd() == chan->kthd){
+		if(lwt->is_blocked_receiver){
+			TAILQ_REMOVE(&chan->head_blocked_receivers, lwt, blocked_receivers);
+			lwt->is_blocked_receiver = 0;
+		}
+	}
+	else{
+		__init_kthd_event(lwt, chan, NULL, chan->kthd, LWT_REMOTE_REMOVE_BLOCKED_RECEIVER_FROM_CHANNEL, 1);
+	}
+}
+
+/**
+ * @brief Parks a select case on the channel until it can take data
+ * @param chan The channel to park on
+ * @param select_case The send case to park
+ */
+void __insert_selector_to_chan(lwt_chan_t chan, struct lwt_select_case * select_case){
+	if(__get_kthd() == chan->kthd){
+		LIST_INSERT_HEAD(&chan->head_selectors, select_case, selectors);
+	}
+	else{
+		//the selector rechecks its cases before it blocks; the owning kthd wakes it if it's already too late
+		__init_kthd_select_event(select_case, chan->kthd, LWT_REMOTE_ADD_SELECTOR_TO_CHANNEL, 0);
+	}
+}
+
+/**
+ * @brief Removes a parked select case from the channel
+ * @param chan The channel the case is parked on
+ * @param select_case The case to remove
+ */
+void __remove_selector_from_chan(lwt_chan_t chan, struct lwt_select_case * select_case){
+	if(__get_kthd() == chan->kthd){
+		LIST_REMOVE(select_case, selectors);
+	}
+	else{
+		//the case lives on the selector's stack, so it has to be unlinked before lwt_select returns
+		__init_kthd_select_event(select_case, chan->kthd, LWT_REMOTE_REMOVE_SELECTOR_FROM_CHANNEL, 1);
+	}
+}
+
+/**
+ * @brief Wakes the select cases parked on the channel; must be called on the kthd owning the channel
+ * @param c The channel that can take data
+ */
+void __wake_selectors(lwt_chan_t c){
+	struct lwt_select_case * select_case;
+	for(select_case = c->head_selectors.lh_first; select_case; select_case = select_case->selectors.le_next){
+		lwt_signal(select_case->selector);
+	}
+}
+
+/**
+ * @brief Checks if a send on the channel would go through right away
+ * @param c The channel to check
+ * @return 1 if the buffer has room or the receiver is parked on the channel; 0 otherwise
+ */
+int __chan_can_send(lwt_chan_t c){
+	if(c->buffer_size > 0){
+		return !__chan_full(c);
+	}
+	return c->rcv_handoff == (unsigned long)RCV_PARKED;
+}
+
+/**
+ * @brief Gets the ring senders of a growable channel push into
+ * @param c The growable channel
+ * @return The newest ring of the chain
+ * @note Senders on other kthds must be counted in num_pushers while they use the ring
+ */
+static inline struct lwt_ring * __chain_tail(lwt_chan_t c){
+	struct lwt_ring * ring = c->push_ring;
+	while(ring->next){
+		ring = ring->next;
+	}
+	return ring;
+}
+
+/**
+ * @brief Links a new ring after the newest ring of a growable channel and seals the old one
+ * @param c The growable channel
+ * @param ring The newest ring as seen by the caller
+ * @param capacity The capacity of the new ring
+ * @param notify Whether to wake the receiver once the old ring is sealed; it may be waiting on it
+ * @return 0 if a newer ring is linked, by us or anyone else; -1 if the channel is at its largest or
+ * the ring couldn't be allocated
+ */
+static int __chain_link(lwt_chan_t c, struct lwt_ring * ring, unsigned int capacity, int notify){
+	struct lwt_ring * next;
+	if(ring->next){
+		return 0;
+	}
+	if(capacity > c->max_size){
+		return -1;
+	}
+	next = __ring_create(capacity, ring->elem_size);
+	if(!next){
+		return -1;
+	}
+	if(__cas((volatile unsigned long *)&ring->next, 0, (unsigned long)next)){
+		//another sender linked one first
+		__ring_destroy(next);
+		return 0;
+	}
+	//the receiver drains what's already claimed, then moves on; senders go straight to the new ring
+	__ring_seal(ring);
+	__cas((volatile unsigned long *)&c->push_ring, (unsigned long)ring, (unsigned long)next);
+	if(notify){
+		__notify_receiver(c);
+	}
+	return 0;
+}
+
+/**
+ * @brief Frees the retired rings of a growable channel if no sender on another kthd can be looking at them
+ * @param c The growable channel; must be owned by the current kthd
+ */
+static void __chain_reclaim(lwt_chan_t c){
+	struct lwt_ring * ring;
+	//retired rings are out of the senders' reach; whoever is still counted may have picked one up before
+	__mem_barrier();
+	if(c->num_pushers){
+		return;
+	}
+	while((ring = c->retired_rings)){
+		c->retired_rings = ring->retired;
+		__ring_destroy(ring);
+	}
+}
+
+/**
+ * @brief Moves the receiver of a growable channel past its ring once it's sealed and drained
+ * @param c The growable channel; must be owned by the current kthd
+ * @return 0 if it moved to the next ring; -1 if the ring may still get data
+ */
+static int __chain_advance(lwt_chan_t c){
+	struct lwt_ring * ring = c->async_ring;
+	if(!__ring_drained(ring)){
+		return -1;
+	}
+	c->async_ring = ring->next;
+	//senders never look past the head of the chain, so it must not point at the ring we retire
+	while(c->push_ring == ring){
+		__cas((volatile unsigned long *)&c->push_ring, (unsigned long)ring, (unsigned long)ring->next);
+	}
+	ring->retired = c->retired_rings;
+	c->retired_rings = ring;
+	__chain_reclaim(c);
+	return 0;
+}
+
+/**
+ * @brief Halves the ring of a growable channel after it stayed mostly empty for a full ring of pops
+ * @param c The growable channel; must be owned by the current kthd
+ */
+static void __chain_shrink(lwt_chan_t c){
+	struct lwt_ring * ring = c->async_ring;
+	//only a lone ring larger than the channel started out with shrinks
+	if(ring->next || (ring->capacity >> 1) < c->buffer_size){
+		c->low_pops = 0;
+		return;
+	}
+	if(__ring_count(ring) > (ring->capacity >> 2)){
+		c->low_pops = 0;
+		return;
+	}
+	if(++c->low_pops < ring->capacity){
+		return;
+	}
+	c->low_pops = 0;
+	__chain_link(c, ring, ring->capacity >> 1, 0);
+}
+
+/**
+ * @brief Pushes an element into a growable channel, doubling its ring instead of reporting it full
+ * @param c The growable channel
+ * @param elem Points to the element to copy in
+ * @return 1 if the ring was empty before the push; 0 if not; -1 if the channel is full at its largest
+ */
+static int __chain_push(lwt_chan_t c, const void * elem){
+	struct lwt_ring * ring;
+	int result;
+	int remote = c->kthd != __get_kthd();
+	if(remote){
+		//keeps the receiver from freeing a ring we picked up
+		fetch_and_add(&c->num_pushers, 1);
+	}
+	ring = __chain_tail(c);
+	while(1){
+		if(remote){
+			result = __ring_push_edge(ring, elem);
+		}
+		else{
+			//the receiver can't run while we do, so an empty ring stays empty until our push
+			result = __ring_empty(ring);
+			if(__ring_push(ring, elem)){
+				result = -1;
+			}
+		}
+		if(result >= 0 || __chain_link(c, ring, ring->capacity << 1, 1)){
+			break;
+		}
+		ring = __chain_tail(c);
+	}
+	if(remote){
+		fetch_and_add(&c->num_pushers, -1);
+	}
+	return result;
+}
+
+/**
+ * @brief Pushes as many of the items as fit into a growable channel, doubling its ring if none fit
+ * @param c The growable channel
+ * @param items The items to add
+ * @param n The number of items
+ * @param edge Set to 1 if the ring was empty before the push; 0 if not
+ * @return The number of items pushed; 0 if the channel is full at its largest
+ */
+static unsigned int __chain_push_n(lwt_chan_t c, void ** items, unsigned int n, int * edge){
+	struct lwt_ring * ring;
+	unsigned int count;
+	int remote = c->kthd != __get_kthd();
+	if(remote){
+		//keeps the receiver from freeing a ring we picked up
+		fetch_and_add(&c->num_pushers, 1);
+	}
+	ring = __chain_tail(c);
+	while(1){
+		if(remote){
+			count = __ring_push_n_edge(ring, items, n, edge);
+		}
+		else{
+			//the receiver can't run while we do, so an empty ring stays empty until our push
+			*edge = __ring_empty(ring);
+			count = __ring_push_n(ring, items, n);
+			*edge = count && *edge;
+		}
+		if(count || __chain_link(c, ring, ring->capacity << 1, 1)){
+			break;
+		}
+		ring = __chain_tail(c);
+	}
+	if(remote){
+		fetch_and_add(&c->num_pushers, -1);
+	}
+	return count;
+}
+
+/**
+ * @brief Pushes an element into the ring of a buffered channel without blocking
+ * @param c The channel to add the element to
+ * @param elem Points to the element to copy in; the data pointer itself unless the channel is typed
+ * @return 1 if the ring was empty before the push, or receivers are parked on a multi-consumer channel;
+ * 0 if not; -1 if the ring is full
+ */
+static inline int __push_data_into_ring(lwt_chan_t c, const void * elem){
+	int was_empty;
+	if(c->type == LWT_CHAN_SPSC){
+		if(c->kthd != __get_kthd()){
+			return __spsc_push_edge(c->spsc_ring, *(void * const *)elem);
+		}
+		was_empty = __spsc_empty(c->spsc_ring);
+		return __spsc_push(c->spsc_ring, *(void * const *)elem) ? -1 : was_empty;
+	}
+	if(c->type == LWT_CHAN_MPMC){
+		if(__ring_push_edge(c->async_ring, elem) < 0){
+			return -1;
+		}
+		//the push fenced; parked receivers are visible
+		return c->head_blocked_receivers.tqh_first != NULL;
+	}
+	if(c->type == LWT_CHAN_GROW){
+		return __chain_push(c, elem);
+	}
+	if(c->kthd != __get_kthd()){
+		return __ring_push_edge(c->async_ring, elem);
+	}
+	//the receiver can't run while we do, so an empty ring stays empty until our push
+	was_empty = __ring_empty(c->async_ring);
+	if(__ring_push(c->async_ring, elem)){
+		return -1;
+	}
+	return was_empty;
+}
+
+/**
+ * @brief Pops an element from the ring of a buffered channel without blocking
+ * @param c The channel to remove the element from
+ * @param elem Buffer the element is copied into
+ * @return 0 if successful; -1 if the ring is empty
+ */
+static inline int __pop_data_from_ring(lwt_chan_t c, void * elem){
+	if(c->type == LWT_CHAN_SPSC){
+		return __spsc_pop(c->spsc_ring, (void **)elem);
+	}
+	if(c->type == LWT_CHAN_MPMC){
+		return __ring_pop_mc(c->async_ring, elem);
+	}
+	if(c->type == LWT_CHAN_GROW){
+		while(__ring_pop(c->async_ring, elem)){
+			if(__chain_advance(c)){
+				return -1;
+			}
+		}
+		return 0;
+	}
+	return __ring_pop(c->async_ring, elem);
+}
+
+/**
+ * @brief Pushes as many of the items as fit into the ring of a buffered channel without blocking
+ * @param c The channel to add the items to
+ * @param items The items to add
+ * @param n The number of items
+ * @param edge Set to 1 if the ring was empty before the push, or receivers are parked on a multi-consumer
+ * channel; 0 if not
+ * @return The number of items pushed; 0 if the ring is full
+ */
+static inline unsigned int __push_n_into_ring(lwt_chan_t c, void ** items, unsigned int n, int * edge){
+	int was_empty;
+	unsigned int count;
+	if(c->type == LWT_CHAN_MPMC){
+		count = __ring_push_n_edge(c->async_ring, items, n, edge);
+		//the push fenced; parked receivers are visible
+		*edge = count && c->head_blocked_receivers.tqh_first != NULL;
+		return count;
+	}
+	if(c->type == LWT_CHAN_GROW){
+		return __chain_push_n(c, items, n, edge);
+	}
+	if(c->kthd != __get_kthd()){
+		if(c->type == LWT_CHAN_SPSC){
+			return __spsc_push_n_edge(c->spsc_ring, items, n, edge);
+		}
+		return __ring_push_n_edge(c->async_ring, items, n, edge);
+	}
+	//the receiver can't run while we do, so an empty ring stays empty until our push
+	if(c->type == LWT_CHAN_SPSC){
+		was_empty = __spsc_empty(c->spsc_ring);
+		count = __spsc_push_n(c->spsc_ring, items, n);
+	}
+	else{
+		was_empty = __ring_empty(c->async_ring);
+		count = __ring_push_n(c->async_ring, items, n);
+	}
+	*edge = count && was_empty;
+	return count;
+}
+
+/**
+ * @brief Pops up to max items from the ring of a buffered channel without blocking
+ * @param c The channel to remove the items from
+ * @param items Set to the items removed
+ * @param max The number of items that fit in the array
+ * @return The number of items popped; 0 if the ring is empty
+ */
+static inline unsigned int __pop_n_from_ring(lwt_chan_t c, void ** items, unsigned int max){
+	unsigned int count;
+	if(c->type == LWT_CHAN_SPSC){
+		return __spsc_pop_n(c->spsc_ring, items, max);
+	}
+	if(c->type == LWT_CHAN_MPMC){
+		//every item is claimed on its own so the other receivers keep going
+		for(count = 0; count < max && !__ring_pop_mc(c->async_ring, &items[count]); ++count);
+		return count;
+	}
+	if(c->type == LWT_CHAN_GROW){
+		while(!(count = __ring_pop_n(c->async_ring, items, max)) && !__chain_advance(c));
+		return count;
+	}
+	return __ring_pop_n(c->async_ring, items, max);
+}
+
+/**
+ * @brief Checks if the ring of a buffered channel is empty
+ * @param c The channel to check
+ * @return 1 if empty; 0 if not
+ */
+static inline int __chan_empty(lwt_chan_t c){
+	struct lwt_ring * ring;
+	if(c->type == LWT_CHAN_SPSC){
+		return __spsc_empty(c->spsc_ring);
+	}
+	if(c->type == LWT_CHAN_GROW){
+		//data may already be waiting in a ring linked after a drained one
+		for(ring = c->async_ring; __ring_empty(ring) && __ring_drained(ring); ring = ring->next);
+		return __ring_empty(ring);
+	}
+	return __ring_empty(c->async_ring);
+}
+
+/**
+ * @brief Wakes whoever is parked on a multi-consumer channel and can now go ahead; must be called on the
+ * kthd owning the channel
+ * @param c The channel
+ */
+void __wake_channel(lwt_chan_t c){
+	lwt_t lwt;
+	if(!__chan_empty(c) && (lwt = c->head_blocked_receivers.tqh_first)){
+		__remove_blocked_receiver_from_chan(c, lwt);
+		lwt_signal(lwt);
+	}
+	if(!__chan_full(c)){
+		if((lwt = c->head_blocked_senders.tqh_first)){
+			__remove_blocked_sender_from_chan(c, lwt);
+			lwt_signal(lwt);
+		}
+		if(c->head_selectors.lh_first){
+			__wake_selectors(c);
+		}
+	}
+}
+
+/**
+ * @brief Raises the group event and wakes the receiver once a push made the buffer non-empty
+ * @param c The channel that was pushed to
+ * @note Multi-consumer channels wake a parked receiver instead
+ */
+static inline void __notify_receiver(lwt_chan_t c){
+	if(c->type == LWT_CHAN_MPMC){
+		//hand the data to one of the parked receivers
+		if(c->kthd == __get_kthd()){
+			__wake_channel(c);
+		}
+		else{
+			__init_kthd_event(NULL, c, NULL, c->kthd, LWT_REMOTE_WAKE_CHANNEL, 0);
+		}
+		return;
+	}
+	__init_event(c);
+	if(c->receiver){
+		lwt_signal(c->receiver);
+	}
+}
+
+/**
+ * @brief Pushes an element into the buffer
+ * @param c The channel to add the element to
+ * @param elem Points to the element to copy in
  * If the buffer is full, it will block until it has capacity
  */
-static void push_data_into_async_buffer(lwt_chan_t c, void * data){
-	//check that the buffer isn't at capacity
-	while(c->end_index >= c->start_index + c->buffer_size){
-		//printf("Blocking async sender: %d\n", lwt_current()->id);
-		__insert_blocked_sender_to_chan(c, lwt_current());
+static void push_data_into_async_buffer(lwt_chan_t c, const void * elem){
+	lwt_t current = lwt_current();
+	unsigned long blocked_at = 0;
+	int result;
+	//block while the buffer is at capacity
+	while((result = __push_data_into_ring(c, elem)) < 0){
+		//printf("Blocking async sender: %d\n", current->id);
+		if(!current->is_blocked_sender){
+			__insert_blocked_sender_to_chan(c, current);
+			//receivers of a multi-consumer channel pop on other kthds; look again after they can see us
+			if(c->type == LWT_CHAN_MPMC){
+				__mem_barrier();
+				continue;
+			}
+		}
+		if(!blocked_at){
+			blocked_at = __stats_now();
+		}
 		lwt_block(LWT_INFO_NSENDING);
 	}
-	unsigned int tail = fetch_and_add(&c->end_index, 1);
-	//printf("Writing to buffer on lwt: %d\n", lwt_current()->id);
-	//insert data into buffer
-	unsigned int index = tail % c->buffer_size;
-	c->num_entries++;
-	assert(c->num_entries <= c->buffer_size);
-	c->async_buffer[index] = data;
-	__init_event(c);
-	//printf("Write complete\n");
-	lwt_signal(c->receiver);
+	//woken without the receiver dequeuing us
+	if(current->is_blocked_sender){
+		__remove_blocked_sender_from_chan(c, current);
+	}
+	if(blocked_at){
+		__stats_snd_blocked(c, blocked_at);
+	}
+	//only the push that makes the buffer non-empty has anyone to wake
+	if(result){
+		__notify_receiver(c);
+	}
+}
+
+/**
+ * @brief Pushes as many of the items as fit into the buffer
+ * @param c The channel to add the items to
+ * @param items The items to add
+ * @param n The number of items
+ * @return The number of items pushed
+ * If the buffer is full, it will block until at least one item fits
+ */
+static int push_n_into_async_buffer(lwt_chan_t c, void ** items, unsigned int n){
+	lwt_t current = lwt_current();
+	unsigned long blocked_at = 0;
+	unsigned int count;
+	int edge;
+	//block while the buffer is at capacity
+	while(!(count = __push_n_into_ring(c, items, n, &edge))){
+		if(!current->is_blocked_sender){
+			__insert_blocked_sender_to_chan(c, current);
+			//receivers of a multi-consumer channel pop on other kthds; look again after they can see us
+			if(c->type == LWT_CHAN_MPMC){
+				__mem_barrier();
+				continue;
+			}
+		}
+		if(!blocked_at){
+			blocked_at = __stats_now();
+		}
+		lwt_block(LWT_INFO_NSENDING);
+	}
+	//woken without the receiver dequeuing us
+	if(current->is_blocked_sender){
+		__remove_blocked_sender_from_chan(c, current);
+	}
+	if(blocked_at){
+		__stats_snd_blocked(c, blocked_at);
+	}
+	//one event and one wakeup for the whole batch
+	if(edge){
+		__notify_receiver(c);
+	}
+	return count;
 }
 
 /**
@@ -111,60 +662,219 @@ static int push_data_into_sync_buffer(lwt_chan_t c, void * data){
 		return -1;
 	}
 
-	lwt_current()->sync_buffer = data;
-	//insert into blocked queue
-	__insert_blocked_sender_to_chan(c, lwt_current());
+	lwt_t current = lwt_current();
+	//a remote receiver may take the data and drop the channel as soon as we're queued
+	lwt_t receiver = c->receiver;
+	current->sync_buffer = data;
+	//raise the event before the sender can be taken off the blocked queue, so it never outlives the data
 	c->num_entries = 1;
 	__init_event(c);
-	if(c->receiver->info == LWT_INFO_NRECEIVING){
+	//insert into blocked queue
+	__insert_blocked_sender_to_chan(c, current);
+	if(receiver->info == LWT_INFO_NRECEIVING){
 		//printf("Signaling receiver that data is ready\n");
-		lwt_signal(c->receiver);
-		lwt_yield(LWT_NULL);
+		//on our kthd, switch straight to the receiver once we block
+		__lwt_signal_next(receiver);
 	}
-	//if receiver isn't waiting to receive block
-	else{
-		//printf("Blocking sender\n");
-		lwt_block(LWT_INFO_NSENDING);
+	//block until the receiver has taken the data; wakeups may be coalesced so check the buffer
+	if(current->sync_buffer){
+		unsigned long blocked_at = __stats_now();
+		while(current->sync_buffer){
+			//printf("Blocking sender\n");
+			lwt_block(LWT_INFO_NSENDING);
+		}
+		__stats_snd_blocked(c, blocked_at);
 	}
+	__stats_snd(c, 1);
 
 	return 0;
 }
 
 /**
- * @brief Pops the data into the buffer
- * @param c The channel to remove the data from
- * @param data The data to remove
- * If the buffer is empty, it will block until there is something to read
+ * @brief Keeps the group event raised for what's left and wakes a blocked sender after a pop
+ * @param c The channel that was popped from
  */
-void * __pop_data_from_async_buffer(lwt_chan_t c){
-	while(c->start_index >= c->end_index){
-		//printf("Blocking async receiver: %d\n", lwt_current()->id);
-		lwt_block(LWT_INFO_NRECEIVING);
+static inline void __finish_async_pop(lwt_chan_t c){
+	if(c->type == LWT_CHAN_MPMC){
+		if(c->kthd == __get_kthd()){
+			__wake_channel(c);
+		}
+		//claiming the head was a full barrier, so whoever parked before it is visible here
+		else if(c->head_blocked_senders.tqh_first || c->head_selectors.lh_first ||
+				(c->head_blocked_receivers.tqh_first && !__chan_empty(c))){
+			__init_kthd_event(NULL, c, NULL, c->kthd, LWT_REMOTE_WAKE_CHANNEL, 0);
+		}
+		return;
+	}
+	if(c->type == LWT_CHAN_GROW){
+		__chain_shrink(c);
+	}
+	//senders only raise the event on the empty to non-empty edge; keep it raised for what's left
+	if(c->channel_group && !__chan_empty(c)){
+		__init_event(c);
 	}
-	unsigned int start_index = fetch_and_add(&c->start_index, 1);
-	//printf("Reading in async receiver: %d\n", lwt_current()->id);
-	assert(c->num_entries > 0);
-	c->num_entries--;
-	unsigned int index = start_index % c->buffer_size;
-	void * data = c->async_buffer[index];
-	//update buffer value
-	//c->async_buffer[index] = NULL;
-	//decrement the number of entries
-	//c->num_entries--;
-	//printf("Async receive complete!\n");
 	lwt_t head_blocked_senders = c->head_blocked_senders.tqh_first;
 	if(head_blocked_senders){
 		__remove_blocked_sender_from_chan(c, head_blocked_senders);
 		lwt_signal(head_blocked_senders);
 	}
+	if(c->head_selectors.lh_first){
+		__wake_selectors(c);
+	}
+}
+
+/**
+ * @brief Pops an element from the buffer of a multi-consumer channel
+ * @param c The channel to remove the element from
+ * @param elem Buffer the element is copied into
+ * If the buffer is empty, it will park the receiver on the channel until there is something to read
+ */
+static void pop_data_from_mpmc_buffer(lwt_chan_t c, void * elem){
+	lwt_t current = lwt_current();
+	while(__pop_data_from_ring(c, elem)){
+		if(!current->is_blocked_receiver){
+			__insert_blocked_receiver_to_chan(c, current);
+			//senders on other kthds look for us after their push; look again after they can see us
+			__mem_barrier();
+			continue;
+		}
+		lwt_block(LWT_INFO_NRECEIVING);
+	}
+	//got the data without a sender dequeuing us
+	if(current->is_blocked_receiver){
+		__remove_blocked_receiver_from_chan(c, current);
+	}
+	__finish_async_pop(c);
+}
+
+/**
+ * @brief Pops an element from the buffer
+ * @param c The channel to remove the element from
+ * @param elem Buffer the element is copied into
+ * If the buffer is empty, it will block until there is something to read
+ */
+static void pop_data_from_async_buffer(lwt_chan_t c, void * elem){
+	if(c->type == LWT_CHAN_MPMC){
+		pop_data_from_mpmc_buffer(c, elem);
+		return;
+	}
+	while(__pop_data_from_ring(c, elem)){
+		//our head has to be visible to the senders before we decide to sleep; see __ring_push_edge
+		__mem_barrier();
+		if(__chan_empty(c)){
+			//printf("Blocking async receiver: %d\n", lwt_current()->id);
+			lwt_block(LWT_INFO_NRECEIVING);
+		}
+	}
+	//printf("Async receive complete!\n");
+	__finish_async_pop(c);
+}
+
+/**
+ * @brief Pops up to max items from the buffer
+ * @param c The channel to remove the items from
+ * @param items Set to the items removed
+ * @param max The number of items that fit in the array
+ * @return The number of items popped
+ * If the buffer is empty, it will block until there is something to read
+ */
+static int pop_n_from_async_buffer(lwt_chan_t c, void ** items, unsigned int max){
+	unsigned int count;
+	if(c->type == LWT_CHAN_MPMC){
+		//park for the first item only; the rest is whatever the other receivers leave us
+		pop_data_from_mpmc_buffer(c, items);
+		return 1 + __pop_n_from_ring(c, items + 1, max - 1);
+	}
+	while(!(count = __pop_n_from_ring(c, items, max))){
+		//our head has to be visible to the senders before we decide to sleep; see __ring_push_edge
+		__mem_barrier();
+		if(__chan_empty(c)){
+			lwt_block(LWT_INFO_NRECEIVING);
+		}
+	}
+	//one wakeup for the whole batch; the following receives wake any other blocked senders
+	__finish_async_pop(c);
+	return count;
+}
+
+/**
+ * @brief Takes the data of the sender at the head of the blocked queue and releases it
+ * @param c The channel; must have a blocked sender
+ * @return The data of the sender
+ */
+static void * __take_from_sync_sender(lwt_chan_t c){
+	//detach the head
+	lwt_t sender = c->head_blocked_senders.tqh_first;
+	__remove_blocked_sender_from_chan(c, sender);
+	//printf("Reading from sync buffer on thread: %d; kthd: %d; received value: %d\n", (int)sender, (int)sender->kthd, (int)sender->sync_buffer);
+	void * data = sender->sync_buffer;
+	assert(data);
+	//let the sender know the data has been taken
+	sender->sync_buffer = NULL;
+
+	//on our kthd, the sender runs as soon as we block again
+	__lwt_signal_next(sender);
+
 	return data;
 }
 
+/**
+ * @brief Hands the data to the receiver if it is parked receiving on the channel
+ * @param c The synchronous channel
+ * @param data The data; not NULL
+ * @return 0 if the receiver took the data; -1 if it isn't parked on the channel
+ * @note Never queues the sender, so the caller doesn't block; the sender may live on any kthd
+ */
+int __chan_try_handoff(lwt_chan_t c, void * data){
+	lwt_t receiver = c->receiver;
+	assert(c->buffer_size == 0);
+	//only a parked receiver with nothing handed over yet leaves the token in the slot
+	if(!receiver || __cas(&c->rcv_handoff, (unsigned long)RCV_PARKED, (unsigned long)data)){
+		return -1;
+	}
+	lwt_signal(receiver);
+	return 0;
+}
+
+/**
+ * @brief Lets try-sends hand their data to the current lwt until it unparks
+ * @param c The synchronous channel; the current lwt must be its receiver
+ */
+void __chan_park_receiver(lwt_chan_t c){
+	//data handed over earlier stays in the slot until it's taken
+	__cas(&c->rcv_handoff, 0, (unsigned long)RCV_PARKED);
+}
+
+/**
+ * @brief Stops try-sends from handing data to the receiver; anything already handed over stays
+ * @param c The synchronous channel; the current lwt must be its receiver
+ */
+void __chan_unpark_receiver(lwt_chan_t c){
+	__cas(&c->rcv_handoff, (unsigned long)RCV_PARKED, 0);
+}
+
+/**
+ * @brief Takes the data a try-send handed over to the receiver
+ * @param c The synchronous channel; the current lwt must be its receiver
+ * @param data Set to the data
+ * @return 0 if there was data; -1 otherwise
+ */
+int __chan_take_handoff(lwt_chan_t c, void ** data){
+	unsigned long handoff = c->rcv_handoff;
+	//only the receiver puts the token in, so anything else is data to take
+	if(!handoff || handoff == (unsigned long)RCV_PARKED){
+		return -1;
+	}
+	*data = (void *)__xchg(&c->rcv_handoff, 0);
+	return 0;
+}
+
 /**
  * @brief Pops the data from the sync buffer
  * @param c The channel being examined
  */
 static void * pop_data_from_sync_buffer(lwt_chan_t c){
+	void * data;
 	if(!c || c->snd_cnt <= 0){
 		perror("NO Senders for receiving channel\n");
 		return NULL;
@@ -172,56 +882,151 @@ static void * pop_data_from_sync_buffer(lwt_chan_t c){
 	//__update_lwt_info(lwt_current(), LWT_INFO_NRECEIVING);
 	//block until there's a sender
 	while(!c->head_blocked_senders.tqh_first){
+		if(!__chan_take_handoff(c, &data)){
+			return data;
+		}
 		//printf("Receiver waiting for sender in %d\n", (int)c);
+		//try-sends can only hand their data over while we're parked here
+		__chan_park_receiver(c);
+		//parked select cases can hand their data over now; the token is in before they look
+		if(c->head_selectors.lh_first){
+			__wake_selectors(c);
+		}
 		lwt_block(LWT_INFO_NRECEIVING);
+		__chan_unpark_receiver(c);
 	}
-	//detach the head
-	lwt_t sender = c->head_blocked_senders.tqh_first;
-	__remove_blocked_sender_from_chan(c, sender);
-	//printf("Reading from sync buffer on thread: %d; kthd: %d; received value: %d\n", (int)sender, (int)sender->kthd, (int)sender->sync_buffer);
-	void * data = sender->sync_buffer;
-	//sender->sync_buffer = NULL;
-	assert(data);
+	return __take_from_sync_sender(c);
+}
 
-	lwt_signal(sender);
+/**
+ * @brief Creates the channel on the receiving thread
+ * @param sz The size of the buffer; rounded up to a power of two, and at least two, for buffered channels
+ * @return A pointer to the initialized channel
+ * @note The buffer holds as many elements as it was rounded up to; e.g. lwt_chan(1) takes two sends
+ * before a sender blocks
+ */
+lwt_chan_t lwt_chan(int sz){
+	return __init_chan(sz, LWT_CHAN_DEFAULT, sizeof(void *));
+}
 
-	return data;
+/**
+ * @brief Creates a buffered channel for exactly one sender on the receiving thread
+ * @param sz The size of the buffer; rounded up to a power of two
+ * @return A pointer to the initialized channel
+ * @note The sender may live on any kthd and can interoperate with groups; handing the channel to a
+ * second concurrent sender is not supported
+ */
+lwt_chan_t lwt_chan_spsc(int sz){
+	assert(sz > 0);
+	return __init_chan(sz, LWT_CHAN_SPSC, sizeof(void *));
 }
 
 /**
- * @brief Creates the channel on the receiving thread
+ * @brief Creates a buffered channel that any number of lwts, on any kthds, can receive from
+ * @param sz The size of the buffer; rounded up to a power of two, and at least two
+ * @return A pointer to the initialized channel
+ * @note Receivers other than the creator get the channel the way senders do (lwt_create_chan,
+ * lwt_snd_chan, lwt_kthd_create), so it stays alive until they deref it. Idle receivers park on the
+ * channel and every item wakes at most one of them. The channel can't be added to a group.
+ */
+lwt_chan_t lwt_chan_mpmc(int sz){
+	assert(sz > 0);
+	return __init_chan(sz, LWT_CHAN_MPMC, sizeof(void *));
+}
+
+/**
+ * @brief Creates a buffered channel whose buffer grows under bursts on the receiving thread
+ * @param sz The size the buffer starts out with and never shrinks below; rounded up to a power of two, and at least two
+ * @param max_sz The size the buffer grows to at most; rounded up to a power of two
+ * @return A pointer to the initialized channel
+ * @note A sender finding the buffer full links a buffer twice the size instead of blocking, until
+ * max_sz is reached. The receiver drains the old buffer first, so each sender's data stays in order,
+ * and halves the buffer again after it stayed at most a quarter full for a full buffer of receives.
+ */
+lwt_chan_t lwt_chan_grow(int sz, int max_sz){
+	lwt_chan_t channel;
+	unsigned int size = 2;
+	assert(sz > 0 && max_sz >= sz);
+	while(size < (unsigned int)max_sz){
+		size <<= 1;
+	}
+	channel = __init_chan(sz, LWT_CHAN_GROW, sizeof(void *));
+	channel->max_size = size;
+	return channel;
+}
+
+/**
+ * @brief Creates a buffered channel of fixed-size messages on the receiving thread
+ * @param elem_size The size of a message
+ * @param sz The size of the buffer; rounded up to a power of two, and at least two
+ * @return A pointer to the initialized channel
+ * @note Messages are copied into the slots of the buffer; use lwt_snd_msg and lwt_rcv_msg
+ */
+lwt_chan_t lwt_chan_typed(unsigned int elem_size, int sz){
+	assert(elem_size > 0 && sz > 0);
+	return __init_chan(sz, LWT_CHAN_TYPED, elem_size);
+}
+
+/**
+ * @brief Creates a channel of the given type on the receiving thread
  * @param sz The size of the buffer
+ * @param type The type of channel
+ * @param elem_size The size of an element of the buffer
  * @return A pointer to the initialized channel
+ * @note The buffer size is what the ring was rounded up to, so it's the number of elements the buffer
+ * really takes before senders block
  */
-lwt_chan_t lwt_chan(int sz){
+static lwt_chan_t __init_chan(int sz, lwt_chan_type_t type, unsigned int elem_size){
 	assert(sz >= 0);
-	lwt_chan_t channel = (lwt_chan_t)malloc(sizeof(struct lwt_channel));
+	lwt_chan_t channel = (lwt_chan_t)__slab_alloc(LWT_SLAB_CHAN);
 	assert(channel);
 	lwt_t current = lwt_current();
 	channel->receiver = current;
 	channel->kthd = current->kthd;
 	LIST_INSERT_HEAD(&current->head_receiver_channel, channel, receiver_channels);
-	LIST_INIT(&channel->head_senders);
 	channel->snd_cnt = 0;
+	//the receiver's reference
+	channel->ref_cnt = 1;
+	channel->is_shared = 0;
 	TAILQ_INIT(&channel->head_blocked_senders);
+	TAILQ_INIT(&channel->head_blocked_receivers);
+	LIST_INIT(&channel->head_selectors);
 	//prepare buffer
-	if(sz > 0){
-		//ensure that the buffer is initialized to NULL
-		channel->async_buffer = (void **)calloc(sz, sizeof(void *));
-		assert(channel->async_buffer);
+	channel->type = type;
+	channel->async_ring = NULL;
+	channel->spsc_ring = NULL;
+	channel->retired_rings = NULL;
+	channel->max_size = 0;
+	channel->num_pushers = 0;
+	channel->low_pops = 0;
+	if(type == LWT_CHAN_SPSC){
+		channel->spsc_ring = __spsc_create(sz);
+		assert(channel->spsc_ring);
 	}
-	else{
-		channel->async_buffer = (void **)calloc(1, sizeof(void *));
+	else if(sz > 0){
+		channel->async_ring = __ring_create(sz, elem_size);
+		assert(channel->async_ring);
 	}
+	channel->push_ring = channel->async_ring;
 	channel->sync_buffer = NULL;
-	channel->start_index = 0;
-	channel->end_index = 0;
-	channel->buffer_size = sz;
+	channel->rcv_handoff = 0;
+	channel->buffer_size = 0;
+	if(channel->spsc_ring){
+		channel->buffer_size = channel->spsc_ring->capacity;
+	}
+	else if(channel->async_ring){
+		channel->buffer_size = channel->async_ring->capacity;
+	}
 	channel->num_entries = 0;
+	channel->event_queued = 0;
 	//prepare group
 	channel->channel_group = NULL;
 	//mark
 	channel->mark = NULL;
+	//watch
+	channel->watch_fd = -1;
+	channel->is_timer = 0;
+	__stats_register(channel);
 	return channel;
 }
 
@@ -235,8 +1040,11 @@ lwt_chan_t lwt_chan(int sz){
 int lwt_snd(lwt_chan_t c, void * data){
 	//data must not be NULL
 	assert(data);
+	//typed channels carry messages, not pointers
+	assert(c->type != LWT_CHAN_TYPED);
 	if(c->buffer_size > 0){
-		push_data_into_async_buffer(c, data);
+		push_data_into_async_buffer(c, &data);
+		__stats_snd(c, 1);
 		return 0;
 	}
 	else{
@@ -244,6 +1052,78 @@ int lwt_snd(lwt_chan_t c, void * data){
 	}
 }
 
+/**
+ * @brief Sends as many of the items over the channel as fit in its buffer
+ * @param c The channel to use for sending
+ * @param items The items to send; none may be NULL
+ * @param n The number of items
+ * @return -1 if there is no receiver; otherwise the number of items sent
+ * Blocks until at least one item is sent; the receiver is woken and the group event raised at most once.
+ * Synchronous channels send one item at a time.
+ */
+int lwt_snd_n(lwt_chan_t c, void ** items, int n){
+	int index;
+	assert(items && n > 0);
+	assert(c->type != LWT_CHAN_TYPED);
+	for(index = 0; index < n; ++index){
+		assert(items[index]);
+	}
+	if(c->buffer_size > 0){
+		index = push_n_into_async_buffer(c, items, n);
+		__stats_snd(c, index);
+		return index;
+	}
+	if(push_data_into_sync_buffer(c, items[0])){
+		return -1;
+	}
+	return 1;
+}
+
+/**
+ * @brief Sends a copy of the message over a typed channel
+ * @param c The typed channel to use for sending
+ * @param msg The message to copy; as large as the channel's message size
+ * @return 0 if successful
+ * If the buffer is full, it will block until it has capacity
+ */
+int lwt_snd_msg(lwt_chan_t c, const void * msg){
+	assert(c->type == LWT_CHAN_TYPED);
+	assert(msg);
+	push_data_into_async_buffer(c, msg);
+	__stats_snd(c, 1);
+	return 0;
+}
+
+/**
+ * @brief Sends the data over the channel only if that won't block
+ * @param c The channel to use for sending
+ * @param data The data for sending
+ * @return 0 if the data was sent; -1 if the buffer is full or, for synchronous channels, the receiver isn't waiting
+ * @note A synchronous send only goes ahead if the receiver is blocked in lwt_rcv on this channel; the
+ * data is handed straight to it
+ */
+int lwt_snd_try(lwt_chan_t c, void * data){
+	int result;
+	//data must not be NULL
+	assert(data);
+	assert(c->type != LWT_CHAN_TYPED);
+	if(c->buffer_size > 0){
+		if((result = __push_data_into_ring(c, &data)) < 0){
+			return -1;
+		}
+		if(result){
+			__notify_receiver(c);
+		}
+		__stats_snd(c, 1);
+		return 0;
+	}
+	if(__chan_try_handoff(c, data)){
+		return -1;
+	}
+	__stats_snd(c, 1);
+	return 0;
+}
+
 
 /**
  * @brief Sends sending over the channel c
@@ -275,18 +1155,121 @@ void lwt_chan_deref(lwt_chan_t c){
 		//printf("Removing receiver (%d) from channel: %d\n", c->receiver->id, (int)c);
 		LIST_REMOVE(c, receiver_channels);
 		c->receiver = NULL;
+		__release_chan(c);
+	}
+	else{
+		__remove_sender_from_chan(c);
+	}
+}
+
+/**
+ * @brief Gets the number of items that can be received from the channel without blocking
+ * @param c The channel to check
+ * @return The number of buffered items; for synchronous channels, the number of senders waiting to hand data over
+ * and the data a try-send already handed over
+ * @note Buffered counts can include items whose senders on other kthds are still writing them; those
+ * are only a push away, so a receive may at most wait for that push
+ */
+int lwt_chan_pending(lwt_chan_t c){
+	lwt_t sender;
+	int count = 0;
+	if(c->buffer_size > 0){
+		return __chan_num_entries(c);
+	}
+	//remote senders are queued by the owning kthd, so only count there
+	assert(c->kthd == __get_kthd());
+	if(c->rcv_handoff && c->rcv_handoff != (unsigned long)RCV_PARKED){
+		count++;
+	}
+	for(sender = c->head_blocked_senders.tqh_first; sender; sender = sender->blocked_senders.tqe_next){
+		count++;
+	}
+	return count;
+}
+
+/**
+ * @brief Gets the number of entries pending in the channel
+ * @param c The channel to check
+ * @return The number of entries in the buffer; for synchronous channels, if a sender has sent
+ */
+unsigned int __chan_num_entries(lwt_chan_t c){
+	struct lwt_ring * ring;
+	unsigned int count = 0, ring_count;
+	if(c->type == LWT_CHAN_SPSC){
+		return __spsc_count(c->spsc_ring);
 	}
-	else if(c->snd_cnt > 0){
-		__remove_sender_from_chan(c, lwt_current());
-		//printf("Removing sender (%d) from channel: %d\n", lwt_current()->id, (int)c);
+	if(c->type == LWT_CHAN_GROW){
+		for(ring = c->async_ring; ring; ring = ring->next){
+			//a ring being sealed briefly counts the positions its tail skipped
+			ring_count = __ring_count(ring);
+			count += ring_count < ring->capacity ? ring_count : ring->capacity;
+		}
+		return count;
 	}
-	//printf("Current sender count: %d\n", c->snd_cnt);
-	if(!c->receiver && c->snd_cnt == 0){
-		//printf("FREEING CHANNEL: %d!!\n", (int)c);
-		if(c->async_buffer){
-			free(c->async_buffer);
+	if(c->buffer_size > 0){
+		return __ring_count(c->async_ring);
+	}
+	return c->num_entries;
+}
+
+/**
+ * @brief Checks if the buffer of a buffered channel is at capacity
+ * @param c The channel to check
+ * @return 1 if full; 0 if not
+ */
+int __chan_full(lwt_chan_t c){
+	struct lwt_ring * ring;
+	int full;
+	if(c->type == LWT_CHAN_SPSC){
+		return __spsc_count(c->spsc_ring) >= c->spsc_ring->capacity;
+	}
+	if(c->type == LWT_CHAN_GROW){
+		if(c->kthd != __get_kthd()){
+			fetch_and_add(&c->num_pushers, 1);
+		}
+		//only full once the newest ring can't double anymore
+		ring = __chain_tail(c);
+		full = __ring_count(ring) >= ring->capacity && (ring->capacity << 1) > c->max_size;
+		if(c->kthd != __get_kthd()){
+			fetch_and_add(&c->num_pushers, -1);
 		}
-		free(c);
+		return full;
+	}
+	return __ring_count(c->async_ring) >= c->async_ring->capacity;
+}
+
+/**
+ * @brief Frees the channel once the last reference to it is dropped
+ * @param c The channel to free
+ */
+void __free_chan(lwt_chan_t c){
+	assert(c->ref_cnt == 0);
+	//printf("FREEING CHANNEL: %d!!\n", (int)c);
+	if(c->watch_fd >= 0){
+		__kthd_unwatch(c);
+	}
+	__free_chan_buffer(c);
+	__stats_unregister(c);
+	__slab_free(LWT_SLAB_CHAN, c);
+}
+
+/**
+ * @brief Frees the buffer of the channel, including every ring of a growable channel
+ * @param c The channel; nobody may be sending or receiving anymore
+ */
+void __free_chan_buffer(lwt_chan_t c){
+	struct lwt_ring * ring;
+	while((ring = c->retired_rings)){
+		c->retired_rings = ring->retired;
+		__ring_destroy(ring);
+	}
+	while((ring = c->async_ring)){
+		c->async_ring = ring->next;
+		__ring_destroy(ring);
+	}
+	if(c->spsc_ring){
+		__spsc_destroy(c->spsc_ring);
+		c->spsc_ring = NULL;
 	}
 }
 
@@ -296,14 +1279,89 @@ void lwt_chan_deref(lwt_chan_t c){
  * @return The data from the channel
  */
 void * lwt_rcv(lwt_chan_t c){
-	//ensure only the thread creating the channel is receiving on it
-	assert(c->receiver == lwt_current());
+	//ensure only the thread creating the channel is receiving on it, unless any lwt may
+	assert(c->receiver == lwt_current() || c->type == LWT_CHAN_MPMC);
+	assert(c->type != LWT_CHAN_TYPED);
+	void * data;
+	if(c->buffer_size > 0){
+		pop_data_from_async_buffer(c, &data);
+	}
+	else if(!(data = pop_data_from_sync_buffer(c))){
+		return NULL;
+	}
+	__stats_rcv(c, 1);
+	return data;
+}
+
+/**
+ * @brief Receives up to max items over the channel
+ * @param c The channel to use for receiving
+ * @param items Set to the items received
+ * @param max The number of items that fit in the array
+ * @return The number of items received
+ * Blocks until at least one item is available; a blocked sender is woken at most once.
+ * Synchronous channels receive one item at a time.
+ */
+int lwt_rcv_n(lwt_chan_t c, void ** items, int max){
+	//ensure only the thread creating the channel is receiving on it, unless any lwt may
+	assert(c->receiver == lwt_current() || c->type == LWT_CHAN_MPMC);
+	assert(items && max > 0);
+	assert(c->type != LWT_CHAN_TYPED);
+	int count;
 	if(c->buffer_size > 0){
-		return __pop_data_from_async_buffer(c);
+		count = pop_n_from_async_buffer(c, items, max);
 	}
 	else{
-		return pop_data_from_sync_buffer(c);
+		items[0] = pop_data_from_sync_buffer(c);
+		count = items[0] ? 1 : 0;
+	}
+	__stats_rcv(c, count);
+	return count;
+}
+
+/**
+ * @brief Receives a message over a typed channel
+ * @param c The typed channel to use for receiving
+ * @param msg Buffer the message is copied into; as large as the channel's message size
+ * @return 0 if successful
+ * If the buffer is empty, it will block until there is something to read
+ */
+int lwt_rcv_msg(lwt_chan_t c, void * msg){
+	//ensure only the thread creating the channel is receiving on it, unless any lwt may
+	assert(c->receiver == lwt_current() || c->type == LWT_CHAN_MPMC);
+	assert(c->type == LWT_CHAN_TYPED);
+	assert(msg);
+	pop_data_from_async_buffer(c, msg);
+	__stats_rcv(c, 1);
+	return 0;
+}
+
+/**
+ * @brief Receives data over the channel only if some is pending
+ * @param c The channel to use for receiving
+ * @param data Set to the data received
+ * @return 0 if data was received; -1 if there was nothing to receive
+ */
+int lwt_rcv_try(lwt_chan_t c, void ** data){
+	//ensure only the thread creating the channel is receiving on it, unless any lwt may
+	assert(c->receiver == lwt_current() || c->type == LWT_CHAN_MPMC);
+	assert(c->type != LWT_CHAN_TYPED);
+	if(c->buffer_size > 0){
+		if(__pop_data_from_ring(c, data)){
+			return -1;
+		}
+		__finish_async_pop(c);
+		__stats_rcv(c, 1);
+		return 0;
 	}
+	if(__chan_take_handoff(c, data)){
+		if(!c->head_blocked_senders.tqh_first){
+			return -1;
+		}
+		*data = __take_from_sync_sender(c);
+	}
+	__stats_rcv(c, 1);
+	return 0;
 }
 
 /**
@@ -11,16 +11,42 @@
 #include "objects.h"
 
 lwt_chan_t lwt_chan(int);
+lwt_chan_t lwt_chan_spsc(int);
+lwt_chan_t lwt_chan_typed(unsigned int, int);
+lwt_chan_t lwt_chan_mpmc(int);
+lwt_chan_t lwt_chan_grow(int, int);
 void lwt_chan_deref(lwt_chan_t);
 int lwt_snd(lwt_chan_t, void *);
 void * lwt_rcv(lwt_chan_t);
+int lwt_snd_n(lwt_chan_t, void **, int);
+int lwt_rcv_n(lwt_chan_t, void **, int);
+int lwt_snd_msg(lwt_chan_t, const void *);
+int lwt_rcv_msg(lwt_chan_t, void *);
+int lwt_snd_try(lwt_chan_t, void *);
+int lwt_rcv_try(lwt_chan_t, void **);
+int lwt_chan_pending(lwt_chan_t);
 int lwt_snd_chan(lwt_chan_t, lwt_chan_t);
 lwt_chan_t lwt_rcv_chan(lwt_chan_t);
 lwt_t lwt_create_chan(lwt_chan_fn_t, lwt_chan_t, lwt_flags_t);
 
 void __insert_sender_to_chan(lwt_chan_t, lwt_t);
-void __remove_sender_from_chan(lwt_chan_t, lwt_t);
+void __free_chan(lwt_chan_t);
+void __free_chan_buffer(lwt_chan_t);
+unsigned int __chan_num_entries(lwt_chan_t);
+int __chan_full(lwt_chan_t);
+void __remove_sender_from_chan(lwt_chan_t);
 void __insert_blocked_sender_to_chan(lwt_chan_t, lwt_t);
 void __remove_blocked_sender_from_chan(lwt_chan_t, lwt_t);
+void __insert_blocked_receiver_to_chan(lwt_chan_t, lwt_t);
+void __remove_blocked_receiver_from_chan(lwt_chan_t, lwt_t);
+void __wake_channel(lwt_chan_t);
+void __insert_selector_to_chan(lwt_chan_t, struct lwt_select_case *);
+void __remove_selector_from_chan(lwt_chan_t, struct lwt_select_case *);
+void __wake_selectors(lwt_chan_t);
+int __chan_can_send(lwt_chan_t);
+int __chan_try_handoff(lwt_chan_t, void *);
+void __chan_park_receiver(lwt_chan_t);
+void __chan_unpark_receiver(lwt_chan_t);
+int __chan_take_handoff(lwt_chan_t, void **);
 
 #endif /* LWT_CHAN_H_ */
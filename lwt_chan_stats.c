@@ -0,0 +1,191 @@
+/*
+ * lwt_chan_stats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_chan_stats.h"
+#include "lwt_chan.h"
+#include "lwt_cgrp.h"
+
+#include "objects.h"
+
+#include "stdio.h"
+#include "string.h"
+
+#ifdef LWT_CHAN_STATS
+
+#include "pthread.h"
+#include "stdlib.h"
+#include "time.h"
+#include "faa.h"
+#include "cas.h"
+
+/**
+ * @brief Every channel with counters; channels are created and freed on any kthd
+ */
+static LIST_HEAD(head_stats_channels, lwt_channel) stats_channels = LIST_HEAD_INITIALIZER(stats_channels);
+
+/**
+ * @brief Guards the list of channels
+ */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Adds the channel to the list of channels with counters
+ * @param c The new channel
+ */
+void __stats_register(lwt_chan_t c){
+	memset((void *)&c->stats, 0, sizeof(struct lwt_chan_stats));
+	pthread_mutex_lock(&stats_lock);
+	LIST_INSERT_HEAD(&stats_channels, c, stats_channels);
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief Removes the channel from the list of channels with counters
+ * @param c The channel about to be freed
+ */
+void __stats_unregister(lwt_chan_t c){
+	pthread_mutex_lock(&stats_lock);
+	LIST_REMOVE(c, stats_channels);
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/**
+ * @brief Counts items sent over the channel
+ * @param c The channel
+ * @param n The number of items
+ */
+void __stats_snd(lwt_chan_t c, unsigned int n){
+	fetch_and_add(&c->stats.num_snds, n);
+}
+
+/**
+ * @brief Counts items received over the channel and samples how many were buffered
+ * @param c The channel
+ * @param n The number of items
+ * @note Occupancy only drops on receives, so sampling right before them catches every peak
+ */
+void __stats_rcv(lwt_chan_t c, unsigned int n){
+	unsigned long entries, peak;
+	fetch_and_add(&c->stats.num_rcvs, n);
+	if(c->buffer_size > 0){
+		entries = __chan_num_entries(c) + n;
+		while((peak = c->stats.peak_entries) < entries && __cas(&c->stats.peak_entries, peak, entries));
+	}
+}
+
+/**
+ * @brief Gets the time for measuring how long senders block
+ * @return Microseconds since an arbitrary point
+ */
+unsigned long __stats_now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long)now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Counts a send that blocked
+ * @param c The channel
+ * @param start When the sender first blocked; from __stats_now
+ */
+void __stats_snd_blocked(lwt_chan_t c, unsigned long start){
+	fetch_and_add(&c->stats.num_snd_blocks, 1);
+	fetch_and_add(&c->stats.blocked_usec, (int)(__stats_now() - start));
+}
+
+/**
+ * @brief Counts an event raised on the channel's group
+ * @param c The channel
+ */
+void __stats_event(lwt_chan_t c){
+	fetch_and_add(&c->stats.num_events, 1);
+}
+
+/**
+ * @brief Orders channels from the most to the least contended
+ * @param a The first channel
+ * @param b The second channel
+ * @return Negative if a is more contended than b; positive if less; 0 if alike
+ */
+static int __stats_compare(const void * a, const void * b){
+	lwt_chan_t first = *(lwt_chan_t const *)a, second = *(lwt_chan_t const *)b;
+	if(first->stats.num_snd_blocks != second->stats.num_snd_blocks){
+		return first->stats.num_snd_blocks < second->stats.num_snd_blocks ? 1 : -1;
+	}
+	if(first->stats.blocked_usec != second->stats.blocked_usec){
+		return first->stats.blocked_usec < second->stats.blocked_usec ? 1 : -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Copies the counters of the channel
+ * @param c The channel
+ * @param stats Set to the counters
+ * @return 0 if successful; -1 if built without LWT_CHAN_STATS
+ */
+int lwt_chan_stats(lwt_chan_t c, struct lwt_chan_stats * stats){
+	memcpy(stats, (void *)&c->stats, sizeof(struct lwt_chan_stats));
+	return 0;
+}
+
+/**
+ * @brief Prints the counters of the most contended channels, labeled by their marks
+ * @param n The number of channels to print
+ * @note Channels are ranked by the number of sends that blocked, then by the time spent blocked
+ */
+void lwt_chan_stats_dump(int n){
+	lwt_chan_t c, * channels;
+	int count = 0, index;
+	pthread_mutex_lock(&stats_lock);
+	for(c = stats_channels.lh_first; c; c = c->stats_channels.le_next){
+		count++;
+	}
+	channels = (lwt_chan_t *)malloc(count * sizeof(lwt_chan_t));
+	if(!channels){
+		pthread_mutex_unlock(&stats_lock);
+		return;
+	}
+	count = 0;
+	for(c = stats_channels.lh_first; c; c = c->stats_channels.le_next){
+		channels[count++] = c;
+	}
+	qsort(channels, count, sizeof(lwt_chan_t), __stats_compare);
+	printf("[STATS] %-10s %10s %10s %8s %12s %8s %8s\n", "mark", "snds", "rcvs", "blocks", "blocked us", "peak", "events");
+	for(index = 0; index < count && index < n; ++index){
+		c = channels[index];
+		printf("[STATS] %-10p %10u %10u %8u %12u %8lu %8u\n", lwt_chan_mark_get(c), c->stats.num_snds,
+				c->stats.num_rcvs, c->stats.num_snd_blocks, c->stats.blocked_usec, c->stats.peak_entries,
+				c->stats.num_events);
+	}
+	pthread_mutex_unlock(&stats_lock);
+	free(channels);
+}
+
+#else
+
+/**
+ * @brief Copies the counters of the channel
+ * @param c The channel
+ * @param stats Set to the counters
+ * @return 0 if successful; -1 if built without LWT_CHAN_STATS
+ */
+int lwt_chan_stats(lwt_chan_t c, struct lwt_chan_stats * stats){
+	(void)c;
+	memset(stats, 0, sizeof(struct lwt_chan_stats));
+	return -1;
+}
+
+/**
+ * @brief Prints the counters of the most contended channels, labeled by their marks
+ * @param n The number of channels to print
+ * @note Prints nothing unless built with LWT_CHAN_STATS
+ */
+void lwt_chan_stats_dump(int n){
+	(void)n;
+}
+
+#endif
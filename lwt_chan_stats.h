@@ -0,0 +1,36 @@
+/*
+ * lwt_chan_stats.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_CHAN_STATS_H_
+#define LWT_CHAN_STATS_H_
+
+#include "objects.h"
+
+int lwt_chan_stats(lwt_chan_t, struct lwt_chan_stats *);
+void lwt_chan_stats_dump(int);
+
+//package functions
+#ifdef LWT_CHAN_STATS
+void __stats_register(lwt_chan_t);
+void __stats_unregister(lwt_chan_t);
+void __stats_snd(lwt_chan_t, unsigned int);
+void __stats_rcv(lwt_chan_t, unsigned int);
+void __stats_snd_blocked(lwt_chan_t, unsigned long);
+void __stats_event(lwt_chan_t);
+unsigned long __stats_now(void);
+#else
+//compiled out; the calls go away entirely
+static inline void __stats_register(lwt_chan_t c){ (void)c; }
+static inline void __stats_unregister(lwt_chan_t c){ (void)c; }
+static inline void __stats_snd(lwt_chan_t c, unsigned int n){ (void)c; (void)n; }
+static inline void __stats_rcv(lwt_chan_t c, unsigned int n){ (void)c; (void)n; }
+static inline void __stats_snd_blocked(lwt_chan_t c, unsigned long start){ (void)c; (void)start; }
+static inline void __stats_event(lwt_chan_t c){ (void)c; }
+static inline unsigned long __stats_now(void){ return 0; }
+#endif
+
+#endif /* LWT_CHAN_STATS_H_ */
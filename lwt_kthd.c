@@ -4,13 +4,57 @@
  *  Created on: Apr 12, 2015
  *      Author: vagrant
  */
+//cpu sets and pthread_setaffinity_np for lwt_kthd_pin
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include "lwt_kthd.h"
 #include "lwt.h"
 #include "lwt_chan.h"
+#include "lwt_cgrp.h"
+#include "lwt_ring.h"
+#include "lwt_slab.h"
+#include "lwt_buf.h"
 #include "assert.h"
 #include "pthread.h"
+#include "cas.h"
 #include "faa.h"
 #include "stdio.h"
+#include "unistd.h"
+#include "sched.h"
+
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+
+/**
+ * @brief Initial number of polls the reaper spins for before sleeping
+ */
+#define KTHD_SPIN_WINDOW 1024
+/**
+ * @brief Default upper bound for the adaptive spin window
+ */
+#define KTHD_SPIN_MAX 16384
+/**
+ * @brief Lower bound the spin window shrinks to when spinning doesn't pay off
+ */
+#define KTHD_SPIN_MIN 16
+/**
+ * @brief Maximum number of events the reaper drains before going back to the scheduler
+ */
+#define KTHD_EVENT_BATCH 32
+/**
+ * @brief Maximum number of descriptor events taken from epoll at once
+ */
+#define KTHD_WATCH_BATCH 32
+/**
+ * @brief Number of spins between two looks at the watched descriptors while the reaper spins
+ */
+#define KTHD_WATCH_SPINS 256
+
+static void __post_kthd_event(lwt_kthd_t, struct kthd_event *, volatile int *);
+static void __post_dead_kthd_event(struct kthd_event *);
 
 /**
  * @brief Pointer to the kthd for the pthread
@@ -24,6 +68,8 @@ __thread lwt_kthd_t pthread_kthd;
  */
 void * pthread_function(void * data){
 	__init__();
+	//the original lwt only waits for the others; it doesn't keep the kthd alive
+	LIST_REMOVE(lwt_current(), lwts_in_kthd);
 	struct lwt_kthd_data * thd_data = (struct lwt_kthd_data *)data;
 	lwt_t lwt = lwt_create_chan(thd_data->channel_fn, thd_data->channel, thd_data->flags);
 	assert(lwt);
@@ -73,43 +119,257 @@ int lwt_kthd_create(lwt_chan_fn_t fn, lwt_chan_t c, lwt_flags_t flags){
 }
 
 /**
- * @brief Pops a kthd event from the buffer
+ * @brief Sets the idle policy of the current kthd
+ * @param mode The idle policy for the reaper
+ * @param spin_max The upper bound of polls to spin for before sleeping; 0 sleeps right away
+ * @return 0 if successful
+ * @note LWT_KTHD_IDLE_POLL never sleeps; it should only be used on kthds pinned to a dedicated core
+ */
+int lwt_kthd_idle(lwt_kthd_idle_t mode, unsigned int spin_max){
+	pthread_kthd->idle_mode = mode;
+	pthread_kthd->spin_max = spin_max;
+	if(pthread_kthd->spin_window > spin_max){
+		pthread_kthd->spin_window = spin_max;
+	}
+	return 0;
+}
+
+/**
+ * @brief Pins the current kthd to a cpu
+ * @param cpu The cpu to run the kthd on
+ * @return 0 if successful; -1 if not
+ */
+int lwt_kthd_pin(int cpu){
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	if(pthread_setaffinity_np(pthread_kthd->pthread, sizeof(cpu_set_t), &cpus)){
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Checks if there are events for the reaper to process
+ * @param kthd The kthd to check
+ * @return 1 if there are pending events; 0 if not
+ */
+int __kthd_has_events(lwt_kthd_t kthd){
+	return kthd->wake_stack || !__ring_empty(&kthd->event_ring);
+}
+
+/**
+ * @brief Wakes the reaper of the kthd if it is asleep
+ * @param kthd The kthd to wake
+ * @note Only issues the wake syscall when the reaper is actually sleeping
+ */
+static void __kthd_notify(lwt_kthd_t kthd){
+	//the pushed event must be visible before we look at the sleep flag
+	__mem_barrier();
+	if(kthd->is_blocked && __xchg(&kthd->is_blocked, 0)){
+		//a reaper watching descriptors sleeps in epoll instead of on the futex
+		if(kthd->wake_fd >= 0){
+			eventfd_write(kthd->wake_fd, 1);
+			return;
+		}
+		syscall(SYS_futex, &kthd->is_blocked, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+}
+
+/**
+ * @brief Pushes the readiness of a watched descriptor into its channel
+ * @param channel The channel watching the descriptor
+ * @param events The epoll events reported for the descriptor
+ * @return 1 if the receiver has something new; 0 if not
+ * @note A channel that still holds an earlier readiness isn't pushed to again, whatever its capacity;
+ * descriptors are edge-triggered, so the receiver has to read until EAGAIN either way
+ */
+static int __kthd_fire_watch(lwt_chan_t channel, unsigned int events){
+	unsigned long long expirations;
+	void * data = (void *)(unsigned long)events;
+	if(channel->is_timer){
+		//also rearms the edge
+		if(read(channel->watch_fd, &expirations, sizeof(expirations)) != sizeof(expirations)){
+			return 0;
+		}
+		data = (void *)(unsigned long)expirations;
+	}
+	//only the reaper sends here and it runs on the receiver's kthd, so nothing races the check
+	if(lwt_chan_pending(channel)){
+		return 0;
+	}
+	return !lwt_snd_try(channel, data);
+}
+
+/**
+ * @brief Takes the ready descriptors out of the epoll set of the kthd and pushes them into their channels
+ * @param kthd The current kthd; must have an epoll set
+ * @param timeout How long to wait for a descriptor in milliseconds; -1 waits until one is ready
+ * @return The number of channels pushed to
+ * @note Returns early when another kthd wakes the reaper through the eventfd
+ */
+static int __kthd_poll_watches(lwt_kthd_t kthd, int timeout){
+	struct epoll_event events[KTHD_WATCH_BATCH];
+	eventfd_t wakeups;
+	int index, num_events, count = 0;
+	num_events = epoll_wait(kthd->epoll_fd, events, KTHD_WATCH_BATCH, timeout);
+	for(index = 0; index < num_events; ++index){
+		if(!events[index].data.ptr){
+			eventfd_read(kthd->wake_fd, &wakeups);
+			continue;
+		}
+		count += __kthd_fire_watch((lwt_chan_t)events[index].data.ptr, events[index].events);
+	}
+	kthd->num_watch_events += count;
+	return count;
+}
+
+/**
+ * @brief Adds the descriptor of the channel to the epoll set of its kthd
+ * @param channel The channel to push the readiness into; must be on the current kthd
+ * @param fd The descriptor to watch
+ * @param events The epoll events to watch for; always edge-triggered
+ * @param is_timer 1 if the descriptor is a timerfd owned by the channel; 0 if not
+ * @return 0 if successful; -1 if the descriptor couldn't be watched
+ * @note The epoll set and its eventfd are created on the first watch and kept until the kthd exits
+ */
+int __kthd_watch(lwt_chan_t channel, int fd, unsigned int events, int is_timer){
+	lwt_kthd_t kthd = channel->kthd;
+	struct epoll_event event;
+	assert(kthd == pthread_kthd);
+	if(kthd->epoll_fd < 0){
+		kthd->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if(kthd->epoll_fd < 0){
+			return -1;
+		}
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		kthd->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(kthd->wake_fd < 0 || epoll_ctl(kthd->epoll_fd, EPOLL_CTL_ADD, kthd->wake_fd, &event)){
+			if(kthd->wake_fd >= 0){
+				close(kthd->wake_fd);
+			}
+			close(kthd->epoll_fd);
+			kthd->wake_fd = -1;
+			kthd->epoll_fd = -1;
+			return -1;
+		}
+	}
+	event.events = events | EPOLLET;
+	event.data.ptr = channel;
+	if(epoll_ctl(kthd->epoll_fd, EPOLL_CTL_ADD, fd, &event)){
+		return -1;
+	}
+	channel->watch_fd = fd;
+	channel->is_timer = is_timer;
+	kthd->num_watches++;
+	return 0;
+}
+
+/**
+ * @brief Removes the descriptor of the channel from the epoll set of its kthd
+ * @param channel The channel watching the descriptor; must be on the current kthd
+ * @note Closes the descriptor if it is a timer; other descriptors belong to the application. A channel
+ * outliving its kthd is unwatched by whoever frees it
+ */
+void __kthd_unwatch(lwt_chan_t channel){
+	lwt_kthd_t kthd = channel->kthd;
+	assert((kthd == pthread_kthd || kthd->is_dead) && channel->watch_fd >= 0);
+	//the application may have closed the descriptor already, which dropped it from the set; an
+	//exited kthd closed the whole set
+	if(kthd->epoll_fd >= 0){
+		epoll_ctl(kthd->epoll_fd, EPOLL_CTL_DEL, channel->watch_fd, NULL);
+	}
+	if(channel->is_timer){
+		close(channel->watch_fd);
+	}
+	channel->watch_fd = -1;
+	kthd->num_watches--;
+}
+
+/**
+ * @brief Closes the epoll set of the kthd; called when the kthd exits
+ * @param kthd The current kthd
+ */
+void __kthd_close_watches(lwt_kthd_t kthd){
+	if(kthd->epoll_fd < 0){
+		return;
+	}
+	close(kthd->wake_fd);
+	close(kthd->epoll_fd);
+	kthd->wake_fd = -1;
+	kthd->epoll_fd = -1;
+}
+
+/**
+ * @brief Idles the reaper until there are events in the buffer
+ * @param kthd The current kthd
+ * Spins on the buffer for the spin window and then sleeps on the futex, or in epoll once descriptors
+ * are watched; the window doubles when an event shows up while spinning and halves when the reaper has to sleep
+ */
+static void __kthd_idle(lwt_kthd_t kthd){
+	unsigned int spin;
+	for(spin = 0; kthd->idle_mode == LWT_KTHD_IDLE_POLL || spin < kthd->spin_window; ++spin){
+		if(__kthd_has_events(kthd)){
+			//spinning paid off; spin longer next time
+			kthd->spin_window = kthd->spin_window < KTHD_SPIN_MIN ? KTHD_SPIN_MIN : kthd->spin_window * 2;
+			if(kthd->spin_window > kthd->spin_max){
+				kthd->spin_window = kthd->spin_max;
+			}
+			return;
+		}
+		//descriptors don't show up in the buffer; a polling reaper would never see them otherwise
+		if(kthd->num_watches && !(spin % KTHD_WATCH_SPINS) && __kthd_poll_watches(kthd, 0)){
+			return;
+		}
+		__cpu_relax();
+	}
+	kthd->spin_window /= 2;
+	if(kthd->spin_window < KTHD_SPIN_MIN && kthd->spin_max >= KTHD_SPIN_MIN){
+		kthd->spin_window = KTHD_SPIN_MIN;
+	}
+	//printf("Putting pthread to sleep on kthd: %d\n", (int)kthd);
+	kthd->is_blocked = 1;
+	__mem_barrier();
+	while(kthd->is_blocked){
+		//recheck after setting the flag so that a concurrent push isn't missed
+		if(__kthd_has_events(kthd)){
+			kthd->is_blocked = 0;
+			break;
+		}
+		if(kthd->epoll_fd >= 0){
+			//one sleep for the buffer, the wake stack and the descriptors
+			if(__kthd_poll_watches(kthd, -1)){
+				kthd->is_blocked = 0;
+			}
+			continue;
+		}
+		syscall(SYS_futex, &kthd->is_blocked, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+	}
+}
+
+/**
+ * @brief Pops a kthd event from the event ring; only called by the kthd's reaper
  * @param kthd The kthd to pop
- * @return The kthd event for the action to perform in the reaper function
- */
-struct kthd_event * __pop_from_buffer(lwt_kthd_t kthd){
-	//return null if there's no data; we're to assume that the buffer is sufficiently large
-	if(kthd->buffer_head >= kthd->buffer_tail){
-		return NULL;
-	}
-	//grab the current head
-	unsigned int head = fetch_and_add(&kthd->buffer_head, 1);
-	head = head % EVENT_BUFFER_SIZE;
-	struct kthd_event * data = kthd->event_buffer[head];
-	kthd->event_buffer[head] = NULL;
-	return data;
+ * @param event The event to copy the action to perform in the reaper function into
+ * @return 0 if successful; -1 if the ring is empty
+ */
+int __pop_from_buffer(lwt_kthd_t kthd, struct kthd_event * event){
+	return __ring_pop(&kthd->event_ring, event);
 }
 
 /**
- * @brief Pushes a kthd event into the event buffer
+ * @brief Pushes a copy of the kthd event into the event ring
  * @param kthd The kthd to modify
- * @param data The data to insert
- * @return 0 if successful; -1 if not
+ * @param event The event to insert
+ * @return 0 if successful; -1 if the ring is full
  */
-int __push_to_buffer(lwt_kthd_t kthd, struct kthd_event * data){
-	//check if full; we're to asssume the buffer is sufficiently large
-	if(kthd->buffer_tail >= kthd->buffer_head + EVENT_BUFFER_SIZE){
+int __push_to_buffer(lwt_kthd_t kthd, struct kthd_event * event){
+	if(__ring_push(&kthd->event_ring, event)){
 		return -1;
 	}
-	unsigned int tail = fetch_and_add(&kthd->buffer_tail, 1) % EVENT_BUFFER_SIZE;
-	kthd->event_buffer[tail] = data;
 	//wake up the pthread
-	pthread_mutex_lock(&kthd->blocked_mutex);
-	if(kthd->is_blocked){
-		kthd->is_blocked = 0;
-		pthread_cond_signal(&kthd->blocked_cv);
-	}
-	pthread_mutex_unlock(&kthd->blocked_mutex);
+	__kthd_notify(kthd);
 	return 0;
 }
 
@@ -118,74 +378,267 @@ int __push_to_buffer(lwt_kthd_t kthd, struct kthd_event * data){
  * @param lwt The lwt for the kthd
  */
 void __init_kthd(lwt_t lwt){
+	unsigned int cache;
 	//ensure block is set to 0's
 	pthread_kthd = (lwt_kthd_t)calloc(1, sizeof(struct lwt_kthd));
 	assert(pthread_kthd);
 	pthread_kthd->pthread = pthread_self();
 	pthread_kthd->is_blocked = 0;
-	pthread_kthd->buffer_head = 0;
-	pthread_kthd->buffer_tail = 0;
+	if(__ring_init(&pthread_kthd->event_ring, EVENT_BUFFER_SIZE, sizeof(struct kthd_event))){
+		assert(0);
+	}
+	pthread_kthd->idle_mode = LWT_KTHD_IDLE_ADAPTIVE;
+	pthread_kthd->spin_window = KTHD_SPIN_WINDOW;
+	pthread_kthd->spin_max = KTHD_SPIN_MAX;
 	LIST_INIT(&pthread_kthd->head_lwts_in_kthd);
 	TAILQ_INIT(&pthread_kthd->head_runnable_threads);
+	pthread_kthd->next_thread = NULL;
+	pthread_kthd->epoll_fd = -1;
+	pthread_kthd->wake_fd = -1;
+	for(cache = 0; cache < LWT_SLAB_NUM_CACHES; ++cache){
+		pthread_kthd->slabs[cache].kthd = pthread_kthd;
+	}
+}
+
+/**
+ * @brief Frees an exited kthd; called once every object of its slab caches has been handed back
+ * @param kthd The kthd
+ */
+void __kthd_free(lwt_kthd_t kthd){
+	assert(kthd->is_dead);
+	__ring_free(&kthd->event_ring);
+	free(kthd);
+}
+
+/**
+ * @brief Queues a wakeup for the end of the reaper's batch, dropping duplicates
+ * @param wakeups The wakeups queued so far in the batch
+ * @param num_wakeups The number of queued wakeups
+ * @param lwt The lwt to wake
+ * @return The new number of queued wakeups
+ */
+static int __queue_wakeup(lwt_t * wakeups, int num_wakeups, lwt_t lwt){
+	int index;
+	for(index = 0; index < num_wakeups; ++index){
+		if(wakeups[index] == lwt){
+			pthread_kthd->num_coalesced++;
+			return num_wakeups;
+		}
+	}
+	wakeups[num_wakeups] = lwt;
+	return num_wakeups + 1;
+}
+
+/**
+ * @brief Performs the remote operation of an event on the current kthd
+ * @param event The event to process
+ * @param wakeups The wakeups queued so far in the batch
+ * @param num_wakeups The number of queued wakeups
+ * @return The new number of queued wakeups
+ */
+static int __process_kthd_event(struct kthd_event * event, lwt_t * wakeups, int num_wakeups){
+	//printf("Received event op: %d; on kthd: %d\n", event->op, (int)pthread_kthd);
+	switch(event->op){
+	case LWT_REMOTE_FREE_CHANNEL:
+			__free_chan(event->channel);
+			break;
+	case LWT_REMOTE_ADD_BLOCKED_SENDER_TO_CHANNEL:
+			__insert_blocked_sender_to_chan(event->channel, event->lwt);
+			if(event->channel->buffer_size > 0){
+				//the receiver may have made room before the sender got queued
+				if(!__chan_full(event->channel)){
+					__remove_blocked_sender_from_chan(event->channel, event->lwt);
+					num_wakeups = __queue_wakeup(wakeups, num_wakeups, event->lwt);
+				}
+			}
+			else{
+				//a level-triggered group drops the event if it looked before the sender got queued
+				if(event->channel->channel_group && event->channel->channel_group->trigger == LWT_CGRP_LEVEL){
+					__init_event(event->channel);
+				}
+				if(event->channel->receiver && event->channel->receiver->info == LWT_INFO_NRECEIVING){
+					//the receiver may have looked for the sender before it got queued
+					num_wakeups = __queue_wakeup(wakeups, num_wakeups, event->channel->receiver);
+				}
+			}
+			break;
+	case LWT_REMOTE_REMOVE_BLOCKED_SENDER_FROM_CHANNEL:
+			__remove_blocked_sender_from_chan(event->channel, event->lwt);
+			break;
+	case LWT_REMOTE_ADD_CHANNEL_TO_GROUP:
+			__insert_channel_to_group(event->group, event->channel);
+			break;
+	case LWT_REMOTE_REMOVE_CHANNEL_FROM_GROUP:
+			lwt_cgrp_rem(event->group, event->channel);
+			break;
+	case LWT_REMOTE_ADD_EVENT_TO_GROUP:
+			//the edge was detected by the sender; the entry count may have moved on since
+			__insert_event(event->channel, event->group);
+			break;
+	case LWT_REMOTE_REMOVE_EVENT_FROM_GROUP:
+			__remove_event(event->channel, event->group);
+			break;
+	case LWT_REMOTE_ADD_SELECTOR_TO_CHANNEL:
+			__insert_selector_to_chan(event->channel, event->select_case);
+			//the channel may have made room before the case got parked
+			if(__chan_can_send(event->channel)){
+				num_wakeups = __queue_wakeup(wakeups, num_wakeups, event->select_case->selector);
+			}
+			break;
+	case LWT_REMOTE_REMOVE_SELECTOR_FROM_CHANNEL:
+			__remove_selector_from_chan(event->channel, event->select_case);
+			break;
+	case LWT_REMOTE_ADD_BLOCKED_RECEIVER_TO_CHANNEL:
+			__insert_blocked_receiver_to_chan(event->channel, event->lwt);
+			//data may have come in before the receiver got parked
+			__wake_channel(event->channel);
+			break;
+	case LWT_REMOTE_REMOVE_BLOCKED_RECEIVER_FROM_CHANNEL:
+			__remove_blocked_receiver_from_chan(event->channel, event->lwt);
+			break;
+	case LWT_REMOTE_WAKE_CHANNEL:
+			__wake_channel(event->channel);
+			break;
+	case LWT_REMOTE_WAKE_BUF_POOL:
+			//the parked lwts are only looked at here, on the kthd owning the pool
+			event->lwt = __buf_pool_wake(event->pool);
+			if(event->lwt){
+				num_wakeups = __queue_wakeup(wakeups, num_wakeups, event->lwt);
+			}
+			break;
+	default:
+		perror("Unknown op provided\n");
+	}
+	if(event->is_done){
+		*event->is_done = 1;
+		num_wakeups = __queue_wakeup(wakeups, num_wakeups, event->originator);
+	}
+	return num_wakeups;
+}
+
+/**
+ * @brief Pushes the lwt onto the wake stack of its kthd; used to signal lwts on other kthds
+ * @param lwt The lwt to wake
+ * @note Does nothing if the lwt is already on the stack; the pending wakeup covers this one
+ */
+void __push_remote_wakeup(lwt_t lwt){
+	lwt_kthd_t kthd = lwt->kthd;
+	unsigned long head;
+	//whatever the wakeup is for must be visible before we check the flag
+	__mem_barrier();
+	if(lwt->wake_queued || __xchg(&lwt->wake_queued, 1)){
+		return;
+	}
+	do{
+		head = kthd->wake_stack;
+		lwt->wake_next = (lwt_t)head;
+	}while(__cas(&kthd->wake_stack, head, (unsigned long)lwt));
+	__kthd_notify(kthd);
+}
+
+/**
+ * @brief Splices the wake stack of the kthd and makes the lwts on it runnable
+ * @param kthd The current kthd
+ * @return The number of lwts woken
+ */
+static int __pop_remote_wakeups(lwt_kthd_t kthd){
+	lwt_t lwt;
+	lwt_t next;
+	int count = 0;
+	if(!kthd->wake_stack){
+		return 0;
+	}
+	//take the whole stack at once; signaled lwts go to the head of the run queue, so waking
+	//the stack newest first leaves them in the order they were pushed
+	lwt = (lwt_t)__xchg(&kthd->wake_stack, 0);
+	while(lwt){
+		next = lwt->wake_next;
+		__compiler_barrier();
+		lwt->wake_queued = 0;
+		lwt_signal(lwt);
+		lwt = next;
+		count++;
+	}
+	kthd->num_remote_wakeups += count;
+	return count;
+}
+
+/**
+ * @brief Marks the current kthd dead and processes what was posted to it; called when the kthd exits
+ * @param kthd The current kthd; its lwts are done
+ * @note Posters that got in before the mark are waited for; later ones see the mark and handle their
+ * events themselves. The kthd is freed by __slab_exit, once the objects of its slab caches are all
+ * handed back
+ */
+void __kthd_exit(lwt_kthd_t kthd){
+	struct kthd_event event;
+	lwt_t wakeups[2];
+	int num_wakeups;
+	unsigned int num_posters;
+	kthd->is_dead = 1;
+	//posters look at the mark after counting themselves in
+	__mem_barrier();
+	do{
+		num_posters = kthd->num_posters;
+		while(!__pop_from_buffer(kthd, &event)){
+			num_wakeups = __process_kthd_event(&event, wakeups, 0);
+			while(num_wakeups > 0){
+				lwt_signal(wakeups[--num_wakeups]);
+			}
+		}
+		//a poster may be waiting for room in the ring
+		if(num_posters){
+			sched_yield();
+		}
+	}while(num_posters);
+	__kthd_close_watches(kthd);
 }
 
 /**
  * @brief Function for the reaper lwt; when all other lwts are blocked, processes events for the kthd
  * @param d Data; unused; needed to match file signature
  * @return NULL
+ * Drains up to KTHD_EVENT_BATCH events per activation and only goes back to the scheduler after the batch;
+ * the scheduler also runs it every KTHD_POLL_INTERVAL dispatches when events are pending
  */
 void * __lwt_buffer(void * d){
-	struct kthd_event * event;
+	struct kthd_event event;
+	lwt_t wakeups[2 * KTHD_EVENT_BATCH];
+	int num_wakeups;
+	unsigned int batch;
+	int num_other;
 	while(lwt_current()->kthd){
-
-		event = __pop_from_buffer(pthread_kthd);
-		if(event){
-			//printf("Received event: %d; on kthd: %d\n", (int)event, (int)pthread_kthd);
-			switch(event->op){
-			case LWT_REMOTE_SIGNAL:
-					lwt_signal(event->lwt);
-					break;
-			case LWT_REMOTE_ADD_SENDER_TO_CHANNEL:
-					__insert_sender_to_chan(event->channel, event->lwt);
-					break;
-			case LWT_REMOTE_REMOVE_SENDER_FROM_CHANNEL:
-					__remove_sender_from_chan(event->channel, event->lwt);
-					break;
-			case LWT_REMOTE_ADD_BLOCKED_SENDER_TO_CHANNEL:
-					__insert_blocked_sender_to_chan(event->channel, event->lwt);
-					break;
-			case LWT_REMOTE_REMOVE_BLOCKED_SENDER_FROM_CHANNEL:
-					__remove_blocked_sender_from_chan(event->channel, event->lwt);
-					break;
-			case LWT_REMOTE_ADD_CHANNEL_TO_GROUP:
-					lwt_cgrp_add(event->group, event->channel);
-					break;
-			case LWT_REMOTE_REMOVE_CHANNEL_FROM_GROUP:
-					lwt_cgrp_rem(event->group, event->channel);
-					break;
-			case LWT_REMOTE_ADD_EVENT_TO_GROUP:
-					__init_event(event->channel);
-					break;
-			case LWT_REMOTE_REMOVE_EVENT_FROM_GROUP:
-					__remove_event(event->channel, event->group);
-					break;
-			default:
-				perror("Unknown op provided\n");
-			}
-			event->is_done = 1;
-			if(event->block){
-				lwt_signal(event->originator);
+		num_wakeups = 0;
+		for(batch = 0; batch < KTHD_EVENT_BATCH && !__pop_from_buffer(pthread_kthd, &event); ++batch){
+			num_wakeups = __process_kthd_event(&event, wakeups, num_wakeups);
+		}
+		//wakeups and descriptors are counted on their own; the batch stats are only about the ring
+		num_other = __pop_remote_wakeups(pthread_kthd);
+		if(pthread_kthd->num_watches){
+			num_other += __kthd_poll_watches(pthread_kthd, 0);
+		}
+		if(!batch && !num_other){
+			//only idle when nothing local can run; otherwise give the kthd back to the scheduler
+			if(pthread_kthd->head_runnable_threads.tqh_first){
+				lwt_block(LWT_INFO_REAPER_READY);
 			}
 			else{
-				free(event);
+				//objects freed here for other kthds would sit in the batches for as long as we sleep
+				__slab_flush(pthread_kthd);
+				__kthd_idle(pthread_kthd);
 			}
+			continue;
 		}
-		else{
-			pthread_mutex_lock(&pthread_kthd->blocked_mutex);
-			//printf("Putting pthread to sleep on kthd: %d\n", (int)pthread_kthd);
-			pthread_kthd->is_blocked = 1;
-			pthread_cond_wait(&pthread_kthd->blocked_cv, &pthread_kthd->blocked_mutex);
-			pthread_mutex_unlock(&pthread_kthd->blocked_mutex);
+		if(batch){
+			pthread_kthd->num_batches++;
+			pthread_kthd->num_events += batch;
+			if(batch > pthread_kthd->max_batch){
+				pthread_kthd->max_batch = batch;
+			}
+		}
+		//wake in reverse since signaled lwts go to the head of the run queue; keeps them in event order
+		while(num_wakeups > 0){
+			lwt_signal(wakeups[--num_wakeups]);
 		}
 		lwt_block(LWT_INFO_REAPER_READY);
 	}
@@ -207,31 +660,27 @@ lwt_kthd_t __get_kthd(){
  * @param remote_group The group to modify
  * @param kthd The kthd to modify
  * @param remote_op The operation to perform
- * @param block Is the operation blocking (generally yes; signal is not)
+ * @param block Is the operation blocking; only needed when the originator reads back what the op changes
+ * @note Events from one originator are processed in the order they were pushed
  */
 void __init_kthd_event(lwt_t remote_lwt, lwt_chan_t remote_chan, lwt_cgrp_t remote_group, lwt_kthd_t kthd, lwt_remote_op_t remote_op, int block){
-	lwt_t current = lwt_current();
-	struct kthd_event * event = (struct kthd_event *)malloc(sizeof(struct kthd_event));
-	assert(event);
-	event->lwt = remote_lwt;
-	event->channel = remote_chan;
-	event->originator = current;
-	assert(event->originator);
-	//assert(event->originator->info == LWT_INFO_NTHD_RUNNABLE);
-	event->kthd = kthd;
-	event->op = remote_op;
-	event->is_done = 0;
-	event->block = block;
+	//the event is copied into the ring; only the completion flag lives on past the push
+	struct kthd_event event;
+	volatile int is_done = 0;
+	event.lwt = remote_lwt;
+	event.channel = remote_chan;
+	event.group = remote_group;
+	event.select_case = NULL;
+	event.pool = NULL;
+	event.originator = lwt_current();
+	assert(event.originator);
+	//assert(event.originator->info == LWT_INFO_NTHD_RUNNABLE);
+	event.op = remote_op;
+	event.is_done = block ? &is_done : NULL;
 	/*char * op;
 	switch(remote_op){
-		case LWT_REMOTE_SIGNAL:
-			op = "Signal";
-			break;
-		case LWT_REMOTE_ADD_SENDER_TO_CHANNEL:
-			op = "Add sender to channel";
-			break;
-		case LWT_REMOTE_REMOVE_SENDER_FROM_CHANNEL:
-			op = "Remove sender from channel";
+		case LWT_REMOTE_FREE_CHANNEL:
+			op = "Free channel";
 			break;
 		case LWT_REMOTE_ADD_BLOCKED_SENDER_TO_CHANNEL:
 			op = "Add blocked sender to channel";
@@ -251,22 +700,109 @@ void __init_kthd_event(lwt_t remote_lwt, lwt_chan_t remote_chan, lwt_cgrp_t remo
 		case LWT_REMOTE_REMOVE_EVENT_FROM_GROUP:
 			op = "Remote remove event from group";
 			break;
+		case LWT_REMOTE_ADD_SELECTOR_TO_CHANNEL:
+			op = "Remote add selector to channel";
+			break;
+		case LWT_REMOTE_REMOVE_SELECTOR_FROM_CHANNEL:
+			op = "Remote remove selector from channel";
+			break;
+		case LWT_REMOTE_ADD_BLOCKED_RECEIVER_TO_CHANNEL:
+			op = "Add blocked receiver to channel";
+			break;
+		case LWT_REMOTE_REMOVE_BLOCKED_RECEIVER_FROM_CHANNEL:
+			op = "Remove blocked receiver from channel";
+			break;
+		case LWT_REMOTE_WAKE_CHANNEL:
+			op = "Wake channel";
+			break;
+		case LWT_REMOTE_WAKE_BUF_POOL:
+			op = "Wake buffer pool";
+			break;
 		default:
 			op = "Unknown";
 	}
-	printf("Created event: %d for op: %s; target lwt: %d; target kthd: %d\n", (int)event, op, (int)remote_lwt, (int)kthd);
+	printf("Created event for op: %s; target lwt: %d; target kthd: %d\n", op, (int)remote_lwt, (int)kthd);
 	*/
-	int result = __push_to_buffer(event->kthd, event);
+	__post_kthd_event(kthd, &event, &is_done);
+}
+
+/**
+ * @brief Initializes and sends an event to park or unpark a select case on a remote channel
+ * @param select_case The case; its channel is owned by the kthd
+ * @param kthd The kthd owning the channel
+ * @param remote_op The operation to perform
+ * @param block If the originator should wait for the operation to complete
+ */
+void __init_kthd_select_event(struct lwt_select_case * select_case, lwt_kthd_t kthd, lwt_remote_op_t remote_op, int block){
+	struct kthd_event event;
+	volatile int is_done = 0;
+	event.lwt = select_case->selector;
+	event.channel = select_case->channel;
+	event.group = NULL;
+	event.select_case = select_case;
+	event.pool = NULL;
+	event.originator = lwt_current();
+	event.op = remote_op;
+	event.is_done = block ? &is_done : NULL;
+	__post_kthd_event(kthd, &event, &is_done);
+}
+
+/**
+ * @brief Sends an event to the kthd owning the pool to wake the lwts parked on it
+ * @param pool The pool; kept alive by the caller's count in num_remote_releasing until the event is handled
+ */
+void __init_kthd_buf_pool_event(lwt_buf_pool_t pool){
+	struct kthd_event event;
+	volatile int is_done = 0;
+	event.lwt = NULL;
+	event.channel = NULL;
+	event.group = NULL;
+	event.select_case = NULL;
+	event.pool = pool;
+	event.originator = lwt_current();
+	event.op = LWT_REMOTE_WAKE_BUF_POOL;
+	event.is_done = NULL;
+	__post_kthd_event(pool->kthd, &event, &is_done);
+}
+
+/**
+ * @brief Handles an event posted to a kthd that has exited
+ * @param event The event
+ * @note The lwts the event is about are gone with the kthd; only freeing a channel is left to do,
+ * and any kthd can do that. A pool wake still has to let go of the pool
+ */
+static void __post_dead_kthd_event(struct kthd_event * event){
+	if(event->op == LWT_REMOTE_FREE_CHANNEL){
+		__free_chan(event->channel);
+	}
+	else if(event->op == LWT_REMOTE_WAKE_BUF_POOL){
+		__buf_pool_wake(event->pool);
+	}
+}
+
+/**
+ * @brief Pushes the event onto the ring of the kthd
+ * @param kthd The kthd to perform the operation
+ * @param event The event to push
+ * @param is_done The completion flag waited on if the event has one
+ */
+static void __post_kthd_event(lwt_kthd_t kthd, struct kthd_event * event, volatile int * is_done){
+	int result;
+	//an exiting kthd drains the ring until every poster counted in has left
+	fetch_and_add(&kthd->num_posters, 1);
+	if(kthd->is_dead){
+		fetch_and_add(&kthd->num_posters, -1);
+		__post_dead_kthd_event(event);
+		return;
+	}
+	result = __push_to_buffer(kthd, event);
 	while(result != 0){
 		lwt_yield(LWT_NULL);
-		result = __push_to_buffer(event->kthd, event);
+		result = __push_to_buffer(kthd, event);
 	}
-	while(block && event->is_done == 0){
+	fetch_and_add(&kthd->num_posters, -1);
+	while(event->is_done && *is_done == 0){
 		//printf("Waiting for return signal event\n");
 		lwt_block(LWT_INFO_NTHD_BLOCKED);
 	}
-	if(block){
-		//printf("Freeing event: %d\n", (int)event);
-		free(event);
-	}
 }
@@ -12,6 +12,8 @@
 
 
 int lwt_kthd_create(lwt_chan_fn_t, lwt_chan_t, lwt_flags_t);
+int lwt_kthd_idle(lwt_kthd_idle_t, unsigned int);
+int lwt_kthd_pin(int);
 
 //package functions
 void __init_kthd(lwt_t);
@@ -21,6 +23,15 @@ lwt_kthd_t __get_kthd();
 
 void * __lwt_buffer(void *);
 void __init_kthd_event(lwt_t, lwt_chan_t, lwt_cgrp_t, lwt_kthd_t, lwt_remote_op_t, int);
+void __init_kthd_select_event(struct lwt_select_case *, lwt_kthd_t, lwt_remote_op_t, int);
+void __init_kthd_buf_pool_event(lwt_buf_pool_t);
+void __push_remote_wakeup(lwt_t);
+int __kthd_has_events(lwt_kthd_t);
+int __kthd_watch(lwt_chan_t, int, unsigned int, int);
+void __kthd_unwatch(lwt_chan_t);
+void __kthd_close_watches(lwt_kthd_t);
+void __kthd_exit(lwt_kthd_t);
+void __kthd_free(lwt_kthd_t);
 
 
 
@@ -0,0 +1,337 @@
+/*
+ * lwt_pipeline.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_pipeline.h"
+#include "lwt.h"
+#include "lwt_chan.h"
+#include "lwt_kthd.h"
+#include "lwt_slab.h"
+
+#include "objects.h"
+
+#include "stdlib.h"
+#include "assert.h"
+#include "faa.h"
+
+/**
+ * @brief Sent down the pipeline behind the last item; its address is the token
+ */
+static char stage_stop;
+
+/**
+ * Token telling a worker that the stage feeding it is done
+ */
+#define STAGE_STOP ((void *)&stage_stop)
+
+/**
+ * @brief Runs a stage function over its input queue until the stop comes through
+ * @param d The stage
+ * @return NULL
+ */
+static void * __stage_worker(void * d){
+	struct lwt_stage * stage = (struct lwt_stage *)d;
+	lwt_pipeline_t pipeline = stage->pipeline;
+	unsigned int index = stage - pipeline->stages;
+	//the pipeline may be freed as soon as the last stage stops; only use copies past that point
+	struct lwt_stage * next = index + 1 < pipeline->num_stages ? &pipeline->stages[index + 1] : NULL;
+	lwt_chan_t input = stage->input, output = next ? next->input : pipeline->output;
+	unsigned int num_stops = next ? next->parallelism : 1;
+	void * item;
+	while((item = lwt_rcv(input)) != STAGE_STOP){
+		item = stage->fn(item, stage->arg);
+		fetch_and_add(&stage->num_items, 1);
+		//a full queue blocks us until the next stage catches up
+		if(item && output){
+			lwt_snd(output, item);
+		}
+	}
+	//the others forwarded everything before counting down, so the last one out queues the stops behind it
+	if(fetch_and_add(&stage->num_running, -1) == 1 && output){
+		while(num_stops--){
+			lwt_snd(output, STAGE_STOP);
+		}
+	}
+	lwt_chan_deref(input);
+	if(output){
+		lwt_chan_deref(output);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Creates the input queues of the stages placed on the current kthd
+ * @param pipeline The pipeline
+ * @param placement The placement of the current kthd
+ */
+static void __pipeline_create_inputs(lwt_pipeline_t pipeline, unsigned int placement){
+	unsigned int index;
+	for(index = 0; index < pipeline->num_stages; ++index){
+		if(pipeline->stages[index].placement == placement){
+			pipeline->stages[index].input = lwt_chan_mpmc(pipeline->stages[index].capacity);
+			assert(pipeline->stages[index].input);
+		}
+	}
+}
+
+/**
+ * @brief Starts the workers of the stages placed on the current kthd; every queue must exist
+ * @param pipeline The pipeline
+ * @param placement The placement of the current kthd
+ */
+static void __pipeline_spawn(lwt_pipeline_t pipeline, unsigned int placement){
+	unsigned int index, worker;
+	struct lwt_stage * stage;
+	lwt_chan_t output;
+	lwt_t lwt;
+	for(index = 0; index < pipeline->num_stages; ++index){
+		stage = &pipeline->stages[index];
+		if(stage->placement != placement){
+			continue;
+		}
+		output = index + 1 < pipeline->num_stages ? pipeline->stages[index + 1].input : pipeline->output;
+		for(worker = 0; worker < stage->parallelism; ++worker){
+			lwt = lwt_create(__stage_worker, stage, LWT_NOJOIN);
+			assert(lwt);
+			//the workers receive from the queue the way senders hold it
+			__insert_sender_to_chan(stage->input, lwt);
+			if(output){
+				__insert_sender_to_chan(output, lwt);
+			}
+		}
+		//the workers keep the queue alive
+		lwt_chan_deref(stage->input);
+	}
+}
+
+/**
+ * @brief Sets up the stages of one placement on a kthd of their own
+ * @param ctl The channel back to the lwt starting the pipeline
+ * @return NULL
+ */
+static void * __pipeline_kthd(lwt_chan_t ctl){
+	lwt_pipeline_t pipeline;
+	unsigned int placement;
+	lwt_chan_t setup = lwt_chan(2);
+	assert(setup);
+	lwt_snd_chan(ctl, setup);
+	pipeline = (lwt_pipeline_t)lwt_rcv(setup);
+	//the start failed on a later kthd; nothing was set up here yet
+	if(pipeline == STAGE_STOP){
+		lwt_chan_deref(setup);
+		lwt_chan_deref(ctl);
+		return NULL;
+	}
+	placement = (unsigned int)lwt_rcv(setup);
+	__pipeline_create_inputs(pipeline, placement);
+	lwt_snd(ctl, pipeline);
+	//every queue exists once we're told to go on
+	lwt_rcv(setup);
+	__pipeline_spawn(pipeline, placement);
+	lwt_snd(ctl, pipeline);
+	lwt_chan_deref(setup);
+	lwt_chan_deref(ctl);
+	return NULL;
+}
+
+/**
+ * @brief Creates an empty pipeline; the current lwt feeds and drains it
+ * @param capacity The capacity of the queue receiving what the last stage returns; 0 to drop it
+ * @return The pipeline; NULL if it couldn't be allocated
+ */
+lwt_pipeline_t lwt_pipeline(unsigned int capacity){
+	lwt_pipeline_t pipeline = (lwt_pipeline_t)lwt_malloc(sizeof(struct lwt_pipeline));
+	if(!pipeline){
+		return NULL;
+	}
+	pipeline->num_stages = 0;
+	pipeline->creator = lwt_current();
+	pipeline->is_started = 0;
+	pipeline->is_drained = 0;
+	pipeline->output = NULL;
+	if(capacity){
+		pipeline->output = lwt_chan(capacity);
+		if(!pipeline->output){
+			lwt_free(pipeline);
+			return NULL;
+		}
+	}
+	return pipeline;
+}
+
+/**
+ * @brief Appends a stage to the pipeline
+ * @param pipeline The pipeline; not started yet
+ * @param fn Function applied to each item with arg; returns the item for the next stage, or NULL to drop it
+ * @param arg Argument passed to every call of fn
+ * @param parallelism The number of workers running fn
+ * @param placement LWT_STAGE_LOCAL for the current kthd; any other number for a kthd shared by the
+ * stages given the same number
+ * @param capacity The capacity of the stage's input queue; a full queue blocks whoever feeds it
+ * @return The index of the stage; -1 if the pipeline has LWT_PIPELINE_MAX_STAGES stages already
+ */
+int lwt_pipeline_stage(lwt_pipeline_t pipeline, lwt_stage_fn_t fn, void * arg, unsigned int parallelism,
+		unsigned int placement, unsigned int capacity){
+	struct lwt_stage * stage;
+	assert(!pipeline->is_started);
+	assert(fn && parallelism > 0 && capacity > 0);
+	if(pipeline->num_stages == LWT_PIPELINE_MAX_STAGES){
+		return -1;
+	}
+	stage = &pipeline->stages[pipeline->num_stages];
+	stage->pipeline = pipeline;
+	stage->fn = fn;
+	stage->arg = arg;
+	stage->parallelism = parallelism;
+	stage->placement = placement;
+	stage->capacity = capacity;
+	stage->input = NULL;
+	stage->num_items = 0;
+	stage->num_running = parallelism;
+	return pipeline->num_stages++;
+}
+
+/**
+ * @brief Creates the kthds and queues of the pipeline and starts every worker
+ * @param pipeline The pipeline
+ * @return 0 if successful; -1 if a kthd couldn't be created, in which case the pipeline isn't started
+ */
+int lwt_pipeline_start(lwt_pipeline_t pipeline){
+	lwt_chan_t ctl, setups[LWT_PIPELINE_MAX_STAGES];
+	unsigned int placements[LWT_PIPELINE_MAX_STAGES];
+	unsigned int num_kthds = 0, index, kthd;
+	assert(pipeline->creator == lwt_current());
+	assert(!pipeline->is_started && pipeline->num_stages > 0);
+	ctl = lwt_chan(LWT_PIPELINE_MAX_STAGES);
+	assert(ctl);
+	//one kthd per placement
+	for(index = 0; index < pipeline->num_stages; ++index){
+		if(pipeline->stages[index].placement == LWT_STAGE_LOCAL){
+			continue;
+		}
+		for(kthd = 0; kthd < num_kthds && placements[kthd] != pipeline->stages[index].placement; ++kthd);
+		if(kthd < num_kthds){
+			continue;
+		}
+		if(lwt_kthd_create(__pipeline_kthd, ctl, LWT_NOJOIN)){
+			//let the kthds created so far go; the pipeline stays as it was
+			for(kthd = 0; kthd < num_kthds; ++kthd){
+				lwt_snd(setups[kthd], STAGE_STOP);
+				lwt_chan_deref(setups[kthd]);
+			}
+			lwt_chan_deref(ctl);
+			return -1;
+		}
+		setups[num_kthds] = lwt_rcv_chan(ctl);
+		placements[num_kthds++] = pipeline->stages[index].placement;
+	}
+	//every kthd has its setup channel in before any of them answer on ctl
+	for(kthd = 0; kthd < num_kthds; ++kthd){
+		lwt_snd(setups[kthd], pipeline);
+		lwt_snd(setups[kthd], (void *)placements[kthd]);
+	}
+	__pipeline_create_inputs(pipeline, LWT_STAGE_LOCAL);
+	for(kthd = 0; kthd < num_kthds; ++kthd){
+		lwt_rcv(ctl);
+	}
+	//workers are only started once the queues they send to exist
+	for(kthd = 0; kthd < num_kthds; ++kthd){
+		lwt_snd(setups[kthd], pipeline);
+	}
+	__pipeline_spawn(pipeline, LWT_STAGE_LOCAL);
+	for(kthd = 0; kthd < num_kthds; ++kthd){
+		lwt_rcv(ctl);
+		lwt_chan_deref(setups[kthd]);
+	}
+	lwt_chan_deref(ctl);
+	__insert_sender_to_chan(pipeline->stages[0].input, pipeline->creator);
+	pipeline->is_started = 1;
+	return 0;
+}
+
+/**
+ * @brief Feeds the item to the first stage; blocks while its queue is full
+ * @param pipeline The pipeline
+ * @param item The item
+ * @return 0 if successful
+ */
+int lwt_pipeline_snd(lwt_pipeline_t pipeline, void * item){
+	assert(pipeline->is_started);
+	assert(item != STAGE_STOP);
+	return lwt_snd(pipeline->stages[0].input, item);
+}
+
+/**
+ * @brief Receives the next item returned by the last stage
+ * @param pipeline The pipeline; must have an output queue
+ * @return The item; NULL once the pipeline has stopped and everything before the stop was received
+ */
+void * lwt_pipeline_rcv(lwt_pipeline_t pipeline){
+	void * item;
+	assert(pipeline->output && pipeline->creator == lwt_current());
+	if(pipeline->is_drained){
+		return NULL;
+	}
+	item = lwt_rcv(pipeline->output);
+	if(item == STAGE_STOP){
+		pipeline->is_drained = 1;
+		return NULL;
+	}
+	return item;
+}
+
+/**
+ * @brief Stops the pipeline once everything fed so far has gone through it
+ * @param pipeline The pipeline
+ * @return 0 if successful
+ * @note Nothing can be fed afterwards; each stage stops after the one feeding it
+ */
+int lwt_pipeline_stop(lwt_pipeline_t pipeline){
+	unsigned int worker;
+	assert(pipeline->is_started && pipeline->creator == lwt_current());
+	for(worker = 0; worker < pipeline->stages[0].parallelism; ++worker){
+		lwt_snd(pipeline->stages[0].input, STAGE_STOP);
+	}
+	lwt_chan_deref(pipeline->stages[0].input);
+	return 0;
+}
+
+/**
+ * @brief Frees the pipeline
+ * @param pipeline The pipeline
+ * @return 0 if successful; -1 if it is still running, or its output hasn't been drained up to the stop
+ */
+int lwt_pipeline_free(lwt_pipeline_t pipeline){
+	assert(pipeline->creator == lwt_current());
+	if(pipeline->is_started && (pipeline->stages[pipeline->num_stages - 1].num_running ||
+			(pipeline->output && !pipeline->is_drained))){
+		return -1;
+	}
+	if(pipeline->output){
+		lwt_chan_deref(pipeline->output);
+	}
+	lwt_free(pipeline);
+	return 0;
+}
+
+/**
+ * @brief Copies the counters of a stage
+ * @param pipeline The pipeline
+ * @param index The index of the stage
+ * @param stats Set to the counters
+ * @return 0 if successful; -1 if there is no such stage
+ * @note Depths are a snapshot; divide the number of items by the time between two calls for the throughput
+ */
+int lwt_pipeline_stats(lwt_pipeline_t pipeline, unsigned int index, struct lwt_stage_stats * stats){
+	struct lwt_stage * stage;
+	if(index >= pipeline->num_stages){
+		return -1;
+	}
+	stage = &pipeline->stages[index];
+	stats->depth = pipeline->is_started && stage->num_running ? __chan_num_entries(stage->input) : 0;
+	stats->num_items = stage->num_items;
+	stats->num_workers = stage->num_running;
+	return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * lwt_pipeline.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_PIPELINE_H_
+#define LWT_PIPELINE_H_
+
+#include "objects.h"
+
+lwt_pipeline_t lwt_pipeline(unsigned int);
+int lwt_pipeline_stage(lwt_pipeline_t, lwt_stage_fn_t, void *, unsigned int, unsigned int, unsigned int);
+int lwt_pipeline_start(lwt_pipeline_t);
+int lwt_pipeline_snd(lwt_pipeline_t, void *);
+void * lwt_pipeline_rcv(lwt_pipeline_t);
+int lwt_pipeline_stop(lwt_pipeline_t);
+int lwt_pipeline_free(lwt_pipeline_t);
+int lwt_pipeline_stats(lwt_pipeline_t, unsigned int, struct lwt_stage_stats *);
+
+#endif /* LWT_PIPELINE_H_ */
@@ -0,0 +1,594 @@
+/*
+ * lwt_ring.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_ring.h"
+#include "lwt_slab.h"
+#include "cas.h"
+
+#include "stdlib.h"
+#include "string.h"
+#include "assert.h"
+
+/**
+ * @brief Gets the slot for a position in the ring
+ * @param ring The ring
+ * @param pos The position
+ * @return The slot holding the position
+ */
+static inline struct lwt_ring_slot * __ring_slot(struct lwt_ring * ring, unsigned long pos){
+	return (struct lwt_ring_slot *)(ring->slots + (pos & ring->mask) * ring->slot_size);
+}
+
+/**
+ * @brief Sizes the ring's slots
+ * @param ring The ring
+ * @param capacity The number of elements the ring holds; rounded up to a power of two, and at least two
+ * @param elem_size The size of an element
+ * @return The number of bytes of slots the ring needs
+ */
+static size_t __ring_layout(struct lwt_ring * ring, unsigned int capacity, unsigned int elem_size){
+	//with a single slot, a published element looks just like a free slot of the next lap
+	unsigned int size = 2;
+	assert(capacity > 0);
+	while(size < capacity){
+		size <<= 1;
+	}
+	ring->capacity = size;
+	ring->mask = size - 1;
+	ring->elem_size = elem_size;
+	//keep the slots word aligned
+	ring->slot_size = (sizeof(struct lwt_ring_slot) + elem_size + sizeof(long) - 1) & ~(sizeof(long) - 1);
+	return (size_t)ring->slot_size * size;
+}
+
+/**
+ * @brief Resets the positions of a ring whose slots are allocated
+ * @param ring The ring
+ */
+static void __ring_reset(struct lwt_ring * ring){
+	unsigned int index;
+	//a slot is free for the producer at position pos when its sequence is pos
+	for(index = 0; index < ring->capacity; ++index){
+		__ring_slot(ring, index)->sequence = index;
+	}
+	ring->head = 0;
+	ring->tail = 0;
+	ring->next = NULL;
+	ring->retired = NULL;
+	ring->seal_pos = 0;
+	ring->is_sealed = 0;
+}
+
+/**
+ * @brief Initializes a ring
+ * @param ring The ring to initialize
+ * @param capacity The number of elements the ring holds; rounded up to a power of two, and at least two
+ * @param elem_size The size of an element
+ * @return 0 if successful; -1 if the slots couldn't be allocated
+ * @see Based on Dmitry Vyukov's bounded MPMC queue: http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ */
+int __ring_init(struct lwt_ring * ring, unsigned int capacity, unsigned int elem_size){
+	ring->slots = (char *)malloc(__ring_layout(ring, capacity, elem_size));
+	if(!ring->slots){
+		return -1;
+	}
+	__ring_reset(ring);
+	return 0;
+}
+
+/**
+ * @brief Frees the slots of the ring
+ * @param ring The ring to free
+ */
+void __ring_free(struct lwt_ring * ring){
+	if(ring->slots){
+		free(ring->slots);
+		ring->slots = NULL;
+	}
+}
+
+/**
+ * @brief Allocates and initializes a ring on its own cache lines
+ * @param capacity The number of elements the ring holds; rounded up to a power of two
+ * @param elem_size The size of an element
+ * @return The ring; NULL if it couldn't be allocated
+ * @note The descriptor comes from the slab caches of the current kthd, and the slots from its lwt_malloc size classes
+ */
+struct lwt_ring * __ring_create(unsigned int capacity, unsigned int elem_size){
+	struct lwt_ring * ring = (struct lwt_ring *)__slab_alloc(LWT_SLAB_RING);
+	size_t size;
+	if(!ring){
+		return NULL;
+	}
+	size = __ring_layout(ring, capacity, elem_size);
+	ring->slots = (char *)lwt_malloc(size);
+	if(!ring->slots){
+		__slab_free(LWT_SLAB_RING, ring);
+		return NULL;
+	}
+	__ring_reset(ring);
+	return ring;
+}
+
+/**
+ * @brief Frees a ring allocated with __ring_create
+ * @param ring The ring to free
+ */
+void __ring_destroy(struct lwt_ring * ring){
+	lwt_free(ring->slots);
+	__slab_free(LWT_SLAB_RING, ring);
+}
+
+/**
+ * @brief Claims the next position of the ring and copies the element into it
+ * @param ring The ring to push into
+ * @param elem The element to copy into the ring
+ * @param pos_out Set to the position the element was published at
+ * @return 0 if successful; -1 if the ring is full
+ */
+static inline int __ring_enqueue(struct lwt_ring * ring, const void * elem, unsigned long * pos_out){
+	struct lwt_ring_slot * slot;
+	unsigned long pos = ring->tail;
+	long dif;
+	while(1){
+		slot = __ring_slot(ring, pos);
+		dif = (long)(slot->sequence - pos);
+		if(dif == 0){
+			//the slot is free; claim the position
+			if(!__cas(&ring->tail, pos, pos + 1)){
+				break;
+			}
+			pos = ring->tail;
+		}
+		else if(dif < 0){
+			//the consumer hasn't freed the slot yet
+			return -1;
+		}
+		else{
+			//another producer took the position
+			pos = ring->tail;
+		}
+	}
+	memcpy(slot + 1, elem, ring->elem_size);
+	//publish the element
+	__compiler_barrier();
+	slot->sequence = pos + 1;
+	*pos_out = pos;
+	return 0;
+}
+
+/**
+ * @brief Pushes a copy of the element into the ring; safe with multiple producers
+ * @param ring The ring to push into
+ * @param elem The element to copy into the ring
+ * @return 0 if successful; -1 if the ring is full
+ */
+int __ring_push(struct lwt_ring * ring, const void * elem){
+	unsigned long pos;
+	return __ring_enqueue(ring, elem, &pos);
+}
+
+/**
+ * @brief Pushes a copy of the element into the ring and reports if the consumer may have to be woken
+ * @param ring The ring to push into
+ * @param elem The element to copy into the ring
+ * @return 1 if the ring was empty up to this element; 0 if not; -1 if the ring is full
+ * @note A consumer about to sleep must issue a full barrier after moving its head and check the ring again
+ */
+int __ring_push_edge(struct lwt_ring * ring, const void * elem){
+	unsigned long pos;
+	if(__ring_enqueue(ring, elem, &pos)){
+		return -1;
+	}
+	//the publish must be visible before we look at where the consumer is
+	__mem_barrier();
+	return ring->head == pos;
+}
+
+/**
+ * @brief Claims as many positions as are free for the elements with a single CAS and copies them in
+ * @param ring The ring to push into
+ * @param elems The array of elements to copy into the ring
+ * @param n The number of elements in the array
+ * @param pos_out Set to the first position the elements were published at
+ * @return The number of elements pushed; 0 if the ring is full
+ */
+static inline unsigned int __ring_enqueue_n(struct lwt_ring * ring, const void * elems, unsigned int n, unsigned long * pos_out){
+	struct lwt_ring_slot * slot;
+	unsigned long pos;
+	unsigned long head;
+	unsigned int count;
+	unsigned int index;
+	do{
+		pos = ring->tail;
+		head = ring->head;
+		//the consumer frees slots in order, so everything below its head is ours to take
+		if(pos - head >= ring->capacity){
+			return 0;
+		}
+		count = ring->capacity - (unsigned int)(pos - head);
+		if(count > n){
+			count = n;
+		}
+	}while(__cas(&ring->tail, pos, pos + count));
+	for(index = 0; index < count; ++index){
+		slot = __ring_slot(ring, pos + index);
+		//the consumer may still be handing back a slot it moved its head past
+		while(slot->sequence != pos + index){
+			__cpu_relax();
+		}
+		memcpy(slot + 1, (const char *)elems + index * ring->elem_size, ring->elem_size);
+		//publish the element
+		__compiler_barrier();
+		slot->sequence = pos + index + 1;
+	}
+	*pos_out = pos;
+	return count;
+}
+
+/**
+ * @brief Pushes copies of up to n elements into the ring; safe with multiple producers
+ * @param ring The ring to push into
+ * @param elems The array of elements to copy into the ring
+ * @param n The number of elements in the array
+ * @return The number of elements pushed; 0 if the ring is full
+ */
+unsigned int __ring_push_n(struct lwt_ring * ring, const void * elems, unsigned int n){
+	unsigned long pos;
+	return __ring_enqueue_n(ring, elems, n, &pos);
+}
+
+/**
+ * @brief Pushes copies of up to n elements into the ring and reports if the consumer may have to be woken
+ * @param ring The ring to push into
+ * @param elems The array of elements to copy into the ring
+ * @param n The number of elements in the array
+ * @param edge Set to 1 if the ring was empty up to these elements; 0 if not
+ * @return The number of elements pushed; 0 if the ring is full
+ * @note A consumer about to sleep must issue a full barrier after moving its head and check the ring again
+ */
+unsigned int __ring_push_n_edge(struct lwt_ring * ring, const void * elems, unsigned int n, int * edge){
+	unsigned long pos;
+	unsigned int count = __ring_enqueue_n(ring, elems, n, &pos);
+	*edge = 0;
+	if(count){
+		//the publish must be visible before we look at where the consumer is
+		__mem_barrier();
+		*edge = ring->head == pos;
+	}
+	return count;
+}
+
+/**
+ * @brief Pops the element at the head of the ring; only safe with a single consumer
+ * @param ring The ring to pop from
+ * @param elem Buffer the element is copied into
+ * @return 0 if successful; -1 if the ring is empty
+ */
+int __ring_pop(struct lwt_ring * ring, void * elem){
+	unsigned long pos = ring->head;
+	struct lwt_ring_slot * slot = __ring_slot(ring, pos);
+	if((long)(slot->sequence - (pos + 1)) < 0){
+		return -1;
+	}
+	__compiler_barrier();
+	memcpy(elem, slot + 1, ring->elem_size);
+	__compiler_barrier();
+	//hand the slot back to the producers for the next lap
+	slot->sequence = pos + ring->capacity;
+	ring->head = pos + 1;
+	return 0;
+}
+
+/**
+ * @brief Pops the element at the head of the ring; safe with multiple consumers
+ * @param ring The ring to pop from
+ * @param elem Buffer the element is copied into
+ * @return 0 if successful; -1 if the ring is empty
+ */
+int __ring_pop_mc(struct lwt_ring * ring, void * elem){
+	struct lwt_ring_slot * slot;
+	unsigned long pos = ring->head;
+	long dif;
+	while(1){
+		slot = __ring_slot(ring, pos);
+		dif = (long)(slot->sequence - (pos + 1));
+		if(dif == 0){
+			//the element is published; claim the position
+			if(!__cas(&ring->head, pos, pos + 1)){
+				break;
+			}
+			pos = ring->head;
+		}
+		else if(dif < 0){
+			//nothing has been published at the head yet
+			return -1;
+		}
+		else{
+			//another consumer took the position
+			pos = ring->head;
+		}
+	}
+	memcpy(elem, slot + 1, ring->elem_size);
+	__compiler_barrier();
+	//hand the slot back to the producers for the next lap
+	slot->sequence = pos + ring->capacity;
+	return 0;
+}
+
+/**
+ * @brief Pops up to max published elements from the head of the ring; only safe with a single consumer
+ * @param ring The ring to pop from
+ * @param elems Array the elements are copied into
+ * @param max The number of elements the array holds
+ * @return The number of elements popped; 0 if the ring is empty
+ */
+unsigned int __ring_pop_n(struct lwt_ring * ring, void * elems, unsigned int max){
+	unsigned long pos = ring->head;
+	struct lwt_ring_slot * slot;
+	unsigned int count;
+	for(count = 0; count < max; ++count){
+		slot = __ring_slot(ring, pos + count);
+		if((long)(slot->sequence - (pos + count + 1)) < 0){
+			break;
+		}
+		__compiler_barrier();
+		memcpy((char *)elems + count * ring->elem_size, slot + 1, ring->elem_size);
+		__compiler_barrier();
+		slot->sequence = pos + count + ring->capacity;
+	}
+	//one store to the shared head for the whole batch
+	ring->head = pos + count;
+	return count;
+}
+
+/**
+ * @brief Checks if the element at the head of the ring has been published
+ * @param ring The ring to check
+ * @return 1 if empty; 0 if not
+ */
+int __ring_empty(struct lwt_ring * ring){
+	unsigned long pos = ring->head;
+	return (long)(__ring_slot(ring, pos)->sequence - (pos + 1)) < 0;
+}
+
+/**
+ * @brief Seals the ring so nothing more can be pushed into it; pushes that already claimed a position
+ * still complete
+ * @param ring The ring to seal
+ */
+void __ring_seal(struct lwt_ring * ring){
+	unsigned long pos;
+	//two laps ahead, no slot's sequence can ever match the tail again, so every push sees a full ring
+	do{
+		pos = ring->tail;
+	}while(__cas(&ring->tail, pos, pos + (ring->capacity << 1)));
+	ring->seal_pos = pos;
+	__compiler_barrier();
+	ring->is_sealed = 1;
+}
+
+/**
+ * @brief Checks if the ring is sealed and everything pushed into it has been popped
+ * @param ring The ring to check
+ * @return 1 if drained; 0 if not
+ */
+int __ring_drained(struct lwt_ring * ring){
+	return ring->is_sealed && ring->head == ring->seal_pos;
+}
+
+/**
+ * @brief Gets the number of claimed positions in the ring
+ * @param ring The ring to check
+ * @return The number of elements in the ring (including ones still being written)
+ */
+unsigned int __ring_count(struct lwt_ring * ring){
+	//read the head first; it never passes the tail
+	unsigned long head = ring->head;
+	__compiler_barrier();
+	if(ring->is_sealed){
+		return (unsigned int)(ring->seal_pos - head);
+	}
+	return (unsigned int)(ring->tail - head);
+}
+
+/**
+ * @brief Allocates and initializes a single-producer single-consumer ring on its own cache lines
+ * @param capacity The number of elements the ring holds; rounded up to a power of two
+ * @return The ring; NULL if it couldn't be allocated
+ */
+struct lwt_spsc_ring * __spsc_create(unsigned int capacity){
+	struct lwt_spsc_ring * ring;
+	unsigned int size = 1;
+	assert(capacity > 0);
+	while(size < capacity){
+		size <<= 1;
+	}
+	ring = (struct lwt_spsc_ring *)__slab_alloc(LWT_SLAB_SPSC);
+	if(!ring){
+		return NULL;
+	}
+	ring->slots = (void **)lwt_malloc(size * sizeof(void *));
+	if(!ring->slots){
+		__slab_free(LWT_SLAB_SPSC, ring);
+		return NULL;
+	}
+	ring->capacity = size;
+	ring->mask = size - 1;
+	ring->tail = 0;
+	ring->cached_head = 0;
+	ring->head = 0;
+	ring->cached_tail = 0;
+	return ring;
+}
+
+/**
+ * @brief Frees a ring allocated with __spsc_create
+ * @param ring The ring to free
+ */
+void __spsc_destroy(struct lwt_spsc_ring * ring){
+	lwt_free(ring->slots);
+	__slab_free(LWT_SLAB_SPSC, ring);
+}
+
+/**
+ * @brief Pushes the element into the ring; only safe for the single producer
+ * @param ring The ring to push into
+ * @param elem The element to push
+ * @return 0 if successful; -1 if the ring is full
+ */
+int __spsc_push(struct lwt_spsc_ring * ring, void * elem){
+	unsigned long pos = ring->tail;
+	if(pos - ring->cached_head >= ring->capacity){
+		//only touch the consumer's line when our copy says we're full
+		ring->cached_head = ring->head;
+		if(pos - ring->cached_head >= ring->capacity){
+			return -1;
+		}
+	}
+	ring->slots[pos & ring->mask] = elem;
+	//publish the element
+	__compiler_barrier();
+	ring->tail = pos + 1;
+	return 0;
+}
+
+/**
+ * @brief Pushes the element into the ring and reports if the consumer may have to be woken
+ * @param ring The ring to push into
+ * @param elem The element to push
+ * @return 1 if the ring was empty up to this element; 0 if not; -1 if the ring is full
+ * @note A consumer about to sleep must issue a full barrier after moving its head and check the ring again
+ */
+int __spsc_push_edge(struct lwt_spsc_ring * ring, void * elem){
+	unsigned long pos = ring->tail;
+	if(__spsc_push(ring, elem)){
+		return -1;
+	}
+	//the publish must be visible before we look at where the consumer is
+	__mem_barrier();
+	ring->cached_head = ring->head;
+	return ring->cached_head == pos;
+}
+
+/**
+ * @brief Pushes up to n elements into the ring; only safe for the single producer
+ * @param ring The ring to push into
+ * @param elems The array of elements to push
+ * @param n The number of elements in the array
+ * @return The number of elements pushed; 0 if the ring is full
+ */
+unsigned int __spsc_push_n(struct lwt_spsc_ring * ring, void ** elems, unsigned int n){
+	unsigned long pos = ring->tail;
+	unsigned int count;
+	unsigned int index;
+	if(pos - ring->cached_head + n > ring->capacity){
+		ring->cached_head = ring->head;
+	}
+	count = ring->capacity - (unsigned int)(pos - ring->cached_head);
+	if(count > n){
+		count = n;
+	}
+	for(index = 0; index < count; ++index){
+		ring->slots[(pos + index) & ring->mask] = elems[index];
+	}
+	//publish the whole batch with one store
+	__compiler_barrier();
+	ring->tail = pos + count;
+	return count;
+}
+
+/**
+ * @brief Pushes up to n elements into the ring and reports if the consumer may have to be woken
+ * @param ring The ring to push into
+ * @param elems The array of elements to push
+ * @param n The number of elements in the array
+ * @param edge Set to 1 if the ring was empty up to these elements; 0 if not
+ * @return The number of elements pushed; 0 if the ring is full
+ * @note A consumer about to sleep must issue a full barrier after moving its head and check the ring again
+ */
+unsigned int __spsc_push_n_edge(struct lwt_spsc_ring * ring, void ** elems, unsigned int n, int * edge){
+	unsigned long pos = ring->tail;
+	unsigned int count = __spsc_push_n(ring, elems, n);
+	*edge = 0;
+	if(count){
+		//the publish must be visible before we look at where the consumer is
+		__mem_barrier();
+		ring->cached_head = ring->head;
+		*edge = ring->cached_head == pos;
+	}
+	return count;
+}
+
+/**
+ * @brief Pops the element at the head of the ring; only safe for the single consumer
+ * @param ring The ring to pop from
+ * @param elem Set to the popped element
+ * @return 0 if successful; -1 if the ring is empty
+ */
+int __spsc_pop(struct lwt_spsc_ring * ring, void ** elem){
+	unsigned long pos = ring->head;
+	if(pos == ring->cached_tail){
+		//only touch the producer's line when our copy says we're empty
+		ring->cached_tail = ring->tail;
+		if(pos == ring->cached_tail){
+			return -1;
+		}
+	}
+	__compiler_barrier();
+	*elem = ring->slots[pos & ring->mask];
+	__compiler_barrier();
+	ring->head = pos + 1;
+	return 0;
+}
+
+/**
+ * @brief Pops up to max elements from the head of the ring; only safe for the single consumer
+ * @param ring The ring to pop from
+ * @param elems Array the elements are copied into
+ * @param max The number of elements the array holds
+ * @return The number of elements popped; 0 if the ring is empty
+ */
+unsigned int __spsc_pop_n(struct lwt_spsc_ring * ring, void ** elems, unsigned int max){
+	unsigned long pos = ring->head;
+	unsigned int count;
+	unsigned int index;
+	if(ring->cached_tail - pos < max){
+		ring->cached_tail = ring->tail;
+	}
+	count = (unsigned int)(ring->cached_tail - pos);
+	if(count > max){
+		count = max;
+	}
+	__compiler_barrier();
+	for(index = 0; index < count; ++index){
+		elems[index] = ring->slots[(pos + index) & ring->mask];
+	}
+	__compiler_barrier();
+	ring->head = pos + count;
+	return count;
+}
+
+/**
+ * @brief Checks if the ring is empty
+ * @param ring The ring to check
+ * @return 1 if empty; 0 if not
+ */
+int __spsc_empty(struct lwt_spsc_ring * ring){
+	return ring->head == ring->tail;
+}
+
+/**
+ * @brief Gets the number of elements in the ring
+ * @param ring The ring to check
+ * @return The number of elements in the ring
+ */
+unsigned int __spsc_count(struct lwt_spsc_ring * ring){
+	//read the head first; it never passes the tail
+	unsigned long head = ring->head;
+	__compiler_barrier();
+	return (unsigned int)(ring->tail - head);
+}
@@ -0,0 +1,41 @@
+/*
+ * lwt_ring.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_RING_H_
+#define LWT_RING_H_
+
+#include "objects.h"
+
+//package functions
+int __ring_init(struct lwt_ring *, unsigned int, unsigned int);
+void __ring_free(struct lwt_ring *);
+struct lwt_ring * __ring_create(unsigned int, unsigned int);
+void __ring_destroy(struct lwt_ring *);
+int __ring_push(struct lwt_ring *, const void *);
+int __ring_push_edge(struct lwt_ring *, const void *);
+unsigned int __ring_push_n(struct lwt_ring *, const void *, unsigned int);
+unsigned int __ring_push_n_edge(struct lwt_ring *, const void *, unsigned int, int *);
+int __ring_pop(struct lwt_ring *, void *);
+int __ring_pop_mc(struct lwt_ring *, void *);
+unsigned int __ring_pop_n(struct lwt_ring *, void *, unsigned int);
+int __ring_empty(struct lwt_ring *);
+unsigned int __ring_count(struct lwt_ring *);
+void __ring_seal(struct lwt_ring *);
+int __ring_drained(struct lwt_ring *);
+
+struct lwt_spsc_ring * __spsc_create(unsigned int);
+void __spsc_destroy(struct lwt_spsc_ring *);
+int __spsc_push(struct lwt_spsc_ring *, void *);
+int __spsc_push_edge(struct lwt_spsc_ring *, void *);
+unsigned int __spsc_push_n(struct lwt_spsc_ring *, void **, unsigned int);
+unsigned int __spsc_push_n_edge(struct lwt_spsc_ring *, void **, unsigned int, int *);
+int __spsc_pop(struct lwt_spsc_ring *, void **);
+unsigned int __spsc_pop_n(struct lwt_spsc_ring *, void **, unsigned int);
+int __spsc_empty(struct lwt_spsc_ring *);
+unsigned int __spsc_count(struct lwt_spsc_ring *);
+
+#endif /* LWT_RING_H_ */
@@ -0,0 +1,158 @@
+/*
+ * lwt_select.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_select.h"
+#include "lwt.h"
+#include "lwt_chan.h"
+#include "lwt_chan_stats.h"
+#include "lwt_cgrp.h"
+
+#include "objects.h"
+
+#include "assert.h"
+#include "cas.h"
+#include "time.h"
+
+/**
+ * @brief Case polled first by the next select on the kthd; rotates so no channel is always favored
+ */
+static __thread unsigned int select_start = 0;
+
+/**
+ * @brief Completes the case if it can go through right away
+ * @param select_case The case to try
+ * @return 0 if the case completed; -1 otherwise
+ */
+static int __select_try(struct lwt_select_case * select_case){
+	lwt_chan_t c = select_case->channel;
+	if(select_case->op == LWT_SELECT_SND){
+		if(c->buffer_size > 0){
+			return lwt_snd_try(c, select_case->data);
+		}
+		//a synchronous case only fires on a receiver parked on this very channel; it's never queued
+		if(__chan_try_handoff(c, select_case->data)){
+			return -1;
+		}
+		__stats_snd(c, 1);
+		return 0;
+	}
+	return lwt_rcv_try(c, &select_case->data);
+}
+
+/**
+ * @brief Gets the microseconds elapsed since start
+ * @param start The time to measure from
+ * @return The microseconds elapsed
+ */
+static long __select_elapsed(struct timespec * start){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/**
+ * @brief Waits until one of the cases can go through and completes exactly that one
+ * @param cases The sends and receives to choose from; receives must be on channels of the current lwt
+ * @param n The number of cases
+ * @param timeout Microseconds to wait for; 0 only polls; negative waits for as long as it takes
+ * @return The index of the completed case; -1 if none completed in time
+ * @note The received data is stored in the data of the case. Send cases park on their channels, so a
+ * receive on any of them, on any kthd, wakes the selector; a synchronous channel takes the data only
+ * once its receiver waits in lwt_rcv or lwt_select. A positive timeout parks the same way, with a one-shot
+ * timerfd watched by the kthd to wake the selector; if no timer can be had, it polls and yields instead.
+ */
+int lwt_select(struct lwt_select_case * cases, int n, int timeout){
+	lwt_t current = lwt_current();
+	struct timespec start;
+	lwt_chan_t timer = LWT_NULL;
+	long elapsed;
+	int index, offset, parked = 0, result = -1;
+	assert(cases && n > 0);
+	for(index = 0; index < n; ++index){
+		assert(cases[index].channel);
+		assert(cases[index].op == LWT_SELECT_SND ||
+				(cases[index].channel->receiver == current && cases[index].channel->type != LWT_CHAN_MPMC));
+		cases[index].selector = current;
+	}
+	if(timeout > 0){
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	}
+	select_start++;
+	while(1){
+		for(offset = 0; offset < n; ++offset){
+			index = (select_start + offset) % n;
+			if(!__select_try(&cases[index])){
+				result = index;
+				break;
+			}
+		}
+		if(result >= 0 || !timeout){
+			break;
+		}
+		if(timeout > 0){
+			elapsed = __select_elapsed(&start);
+			if(elapsed >= timeout){
+				break;
+			}
+			//armed once, for what's left of the timeout; it fires into a channel we receive
+			if(!parked && !timer){
+				timer = __timer_chan((unsigned long long)(timeout - elapsed) * 1000ULL);
+			}
+			if(!timer){
+				lwt_yield(LWT_NULL);
+				continue;
+			}
+		}
+		if(!parked){
+			//park once on every case, then look again in case room was made or data handed over in between
+			for(index = 0; index < n; ++index){
+				if(cases[index].op == LWT_SELECT_SND){
+					__insert_selector_to_chan(cases[index].channel, &cases[index]);
+				}
+				else if(!cases[index].channel->buffer_size){
+					__chan_park_receiver(cases[index].channel);
+				}
+			}
+			parked = 1;
+			continue;
+		}
+		//our heads have to be visible to the senders before we decide to sleep; see __ring_push_edge
+		__mem_barrier();
+		for(index = 0; index < n; ++index){
+			if(cases[index].op == LWT_SELECT_RCV && lwt_chan_pending(cases[index].channel)){
+				break;
+			}
+		}
+		//the timer fires no earlier than the deadline; the elapsed check above ends the select
+		if(index < n || (timer && lwt_chan_pending(timer))){
+			continue;
+		}
+		for(index = 0; index < n; ++index){
+			//parked senders on our synchronous channels can hand their data over now
+			if(cases[index].op == LWT_SELECT_RCV && !cases[index].channel->buffer_size && cases[index].channel->head_selectors.lh_first){
+				__wake_selectors(cases[index].channel);
+			}
+		}
+		//senders wake the receiver and receivers wake the parked cases; either way, look again
+		lwt_block(LWT_INFO_NRECEIVING);
+	}
+	if(parked){
+		//data handed over to a case we didn't complete is received next time
+		for(index = 0; index < n; ++index){
+			if(cases[index].op == LWT_SELECT_SND){
+				__remove_selector_from_chan(cases[index].channel, &cases[index]);
+			}
+			else if(!cases[index].channel->buffer_size){
+				__chan_unpark_receiver(cases[index].channel);
+			}
+		}
+	}
+	if(timer){
+		//cancels the deadline if it hasn't passed yet
+		lwt_chan_deref(timer);
+	}
+	return result;
+}
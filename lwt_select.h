@@ -0,0 +1,15 @@
+/*
+ * lwt_select.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_SELECT_H_
+#define LWT_SELECT_H_
+
+#include "objects.h"
+
+int lwt_select(struct lwt_select_case *, int, int);
+
+#endif /* LWT_SELECT_H_ */
@@ -0,0 +1,253 @@
+/*
+ * lwt_slab.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+#include "lwt_slab.h"
+#include "lwt_kthd.h"
+
+#include "objects.h"
+
+#include "stdlib.h"
+#include "assert.h"
+#include "cas.h"
+#include "faa.h"
+
+/**
+ * @brief Size of the objects of each cache
+ */
+static const unsigned int slab_sizes[LWT_SLAB_NUM_CACHES] = {
+	[LWT_SLAB_CHAN] = sizeof(struct lwt_channel),
+	[LWT_SLAB_CGRP] = sizeof(struct lwt_cgrp),
+	[LWT_SLAB_RING] = sizeof(struct lwt_ring),
+	[LWT_SLAB_SPSC] = sizeof(struct lwt_spsc_ring),
+	[LWT_SLAB_MALLOC_32] = sizeof(struct lwt_malloc_header) + 32,
+	[LWT_SLAB_MALLOC_64] = sizeof(struct lwt_malloc_header) + 64,
+	[LWT_SLAB_MALLOC_128] = sizeof(struct lwt_malloc_header) + 128,
+	[LWT_SLAB_MALLOC_256] = sizeof(struct lwt_malloc_header) + 256,
+	[LWT_SLAB_MALLOC_512] = sizeof(struct lwt_malloc_header) + 512,
+	[LWT_SLAB_MALLOC_1024] = sizeof(struct lwt_malloc_header) + 1024,
+	[LWT_SLAB_MALLOC_2048] = sizeof(struct lwt_malloc_header) + 2048,
+	[LWT_SLAB_MALLOC_4096] = sizeof(struct lwt_malloc_header) + 4096
+};
+
+/**
+ * @brief Gets where the header of an object starts
+ * @param cache The cache of the object
+ * @return The offset of the header from the object
+ */
+static inline unsigned int __slab_header(lwt_slab_cache_t cache){
+	return (slab_sizes[cache] + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+/**
+ * @brief Gets the distance between two objects of a chunk; objects start on their own cache lines
+ * @param cache The cache
+ * @return The stride of the objects
+ */
+static inline unsigned int __slab_stride(lwt_slab_cache_t cache){
+	return (__slab_header(cache) + sizeof(struct lwt_slab_obj) + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+}
+
+/**
+ * @brief Gets the object a header belongs to
+ * @param cache The cache of the object
+ * @param obj The header
+ * @return The object
+ */
+static inline void * __slab_payload(lwt_slab_cache_t cache, struct lwt_slab_obj * obj){
+	return (char *)obj - __slab_header(cache);
+}
+
+/**
+ * @brief Carves a new chunk into free objects
+ * @param slab The cache of the current kthd
+ * @param cache Which cache it is
+ * @return 0 if successful; -1 if the chunk couldn't be allocated
+ */
+static int __slab_grow(struct lwt_slab * slab, lwt_slab_cache_t cache){
+	void * mem;
+	unsigned int index, stride = __slab_stride(cache);
+	struct lwt_slab_obj * obj;
+	//the first cache line links the chunk; the objects follow it
+	if(posix_memalign(&mem, CACHE_LINE_SIZE, CACHE_LINE_SIZE + (size_t)stride * LWT_SLAB_CHUNK)){
+		return -1;
+	}
+	*(void **)mem = slab->chunks;
+	slab->chunks = mem;
+	for(index = 0; index < LWT_SLAB_CHUNK; ++index){
+		obj = (struct lwt_slab_obj *)((char *)mem + CACHE_LINE_SIZE + (size_t)index * stride + __slab_header(cache));
+		obj->slab = slab;
+		obj->next = slab->free_objs;
+		slab->free_objs = obj;
+	}
+	return 0;
+}
+
+/**
+ * @brief Frees the chunks of every cache of an exited kthd, and the kthd itself
+ * @param kthd The kthd; every object of its caches has been handed back
+ */
+static void __slab_release(lwt_kthd_t kthd){
+	unsigned int cache;
+	void * chunk;
+	for(cache = 0; cache < LWT_SLAB_NUM_CACHES; ++cache){
+		while((chunk = kthd->slabs[cache].chunks)){
+			kthd->slabs[cache].chunks = *(void **)chunk;
+			free(chunk);
+		}
+	}
+	__kthd_free(kthd);
+}
+
+/**
+ * @brief Hands a batch of objects back to the kthd owning them
+ * @param batch The batch; empty afterwards
+ */
+static void __slab_flush_batch(struct lwt_slab_batch * batch){
+	lwt_kthd_t kthd;
+	unsigned long head;
+	unsigned int count = batch->count;
+	if(!count){
+		return;
+	}
+	kthd = batch->slab->kthd;
+	//only pushes race here; the owner takes the whole stack, so there's no ABA to worry about
+	do{
+		head = batch->slab->remote_free;
+		batch->tail->next = (struct lwt_slab_obj *)head;
+	}while(__cas(&batch->slab->remote_free, head, (unsigned long)batch->head));
+	batch->slab = NULL;
+	batch->head = NULL;
+	batch->tail = NULL;
+	batch->count = 0;
+	//the debt only reaches 0 once the owner has exited and this was the last of its objects
+	if(fetch_and_add(&kthd->slab_debt, -(int)count) == (int)count){
+		__slab_release(kthd);
+	}
+}
+
+/**
+ * @brief Takes an object from the cache of the current kthd
+ * @param cache Which cache to allocate from
+ * @return The object, aligned to a cache line; NULL if the cache couldn't grow
+ */
+void * __slab_alloc(lwt_slab_cache_t cache){
+	lwt_kthd_t kthd = __get_kthd();
+	struct lwt_slab * slab = &kthd->slabs[cache];
+	struct lwt_slab_obj * obj;
+	if(!slab->free_objs){
+		//take everything freed on other kthds at once
+		if(slab->remote_free){
+			slab->free_objs = (struct lwt_slab_obj *)__xchg(&slab->remote_free, 0);
+		}
+		else if(__slab_grow(slab, cache)){
+			return NULL;
+		}
+	}
+	obj = slab->free_objs;
+	slab->free_objs = obj->next;
+	kthd->num_slab_objs++;
+	return __slab_payload(cache, obj);
+}
+
+/**
+ * @brief Returns an object to the cache it was allocated from
+ * @param cache Which cache the object came from
+ * @param mem The object
+ * @note Objects of other kthds are batched and handed back LWT_SLAB_BATCH at a time
+ */
+void __slab_free(lwt_slab_cache_t cache, void * mem){
+	lwt_kthd_t kthd = __get_kthd();
+	struct lwt_slab_obj * obj = (struct lwt_slab_obj *)((char *)mem + __slab_header(cache));
+	struct lwt_slab_batch * batch = &kthd->slab_batches[cache];
+	if(obj->slab == &kthd->slabs[cache]){
+		obj->next = obj->slab->free_objs;
+		obj->slab->free_objs = obj;
+		kthd->num_slab_objs--;
+		return;
+	}
+	if(batch->slab != obj->slab){
+		__slab_flush_batch(batch);
+		batch->slab = obj->slab;
+		batch->tail = obj;
+	}
+	obj->next = batch->head;
+	batch->head = obj;
+	if(++batch->count >= LWT_SLAB_BATCH){
+		__slab_flush_batch(batch);
+	}
+}
+
+/**
+ * @brief Hands every pending batch back to the kthds owning them; called before the kthd goes idle
+ * @param kthd The current kthd
+ */
+void __slab_flush(lwt_kthd_t kthd){
+	unsigned int cache;
+	for(cache = 0; cache < LWT_SLAB_NUM_CACHES; ++cache){
+		__slab_flush_batch(&kthd->slab_batches[cache]);
+	}
+}
+
+/**
+ * @brief Hands the pending batches back and frees the caches of the current kthd, once nothing
+ * carved from them is still held elsewhere; called when the kthd exits
+ * @param kthd The current kthd; may be freed on return, and must not allocate or free afterwards
+ * @note Otherwise the kthd that hands the last object back frees them
+ */
+void __slab_exit(lwt_kthd_t kthd){
+	unsigned int num_objs = kthd->num_slab_objs;
+	__slab_flush(kthd);
+	if(fetch_and_add(&kthd->slab_debt, (int)num_objs) == -(int)num_objs){
+		__slab_release(kthd);
+	}
+}
+
+/**
+ * @brief Allocates memory from the size classes of the current kthd
+ * @param size The number of bytes
+ * @return The memory, aligned like malloc's; NULL if it couldn't be allocated
+ * @note Requests above the largest class go to malloc. The memory can be freed on any kthd; it is
+ * batched back to the kthd that allocated it, so producers and consumers on different kthds don't
+ * contend on the allocator
+ */
+void * lwt_malloc(size_t size){
+	struct lwt_malloc_header * header;
+	unsigned int cache = LWT_SLAB_MALLOC_32;
+	//the classes double from 32 bytes
+	while(cache <= LWT_SLAB_MALLOC_4096 && (size_t)(32 << (cache - LWT_SLAB_MALLOC_32)) < size){
+		++cache;
+	}
+	if(cache > LWT_SLAB_MALLOC_4096){
+		cache = LWT_SLAB_NUM_CACHES;
+		header = (struct lwt_malloc_header *)malloc(sizeof(struct lwt_malloc_header) + size);
+	}
+	else{
+		header = (struct lwt_malloc_header *)__slab_alloc((lwt_slab_cache_t)cache);
+	}
+	if(!header){
+		return NULL;
+	}
+	header->cache = cache;
+	return header + 1;
+}
+
+/**
+ * @brief Frees memory allocated with lwt_malloc, on any kthd
+ * @param mem The memory; NULL does nothing
+ */
+void lwt_free(void * mem){
+	struct lwt_malloc_header * header;
+	if(!mem){
+		return;
+	}
+	header = (struct lwt_malloc_header *)mem - 1;
+	if(header->cache == LWT_SLAB_NUM_CACHES){
+		free(header);
+		return;
+	}
+	assert(header->cache >= LWT_SLAB_MALLOC_32 && header->cache <= LWT_SLAB_MALLOC_4096);
+	__slab_free((lwt_slab_cache_t)header->cache, header);
+}
@@ -0,0 +1,24 @@
+/*
+ * lwt_slab.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: vagrant
+ */
+
+#ifndef LWT_SLAB_H_
+#define LWT_SLAB_H_
+
+#include "objects.h"
+
+#include "stddef.h"
+
+void * lwt_malloc(size_t);
+void lwt_free(void *);
+
+//package functions
+void * __slab_alloc(lwt_slab_cache_t);
+void __slab_free(lwt_slab_cache_t, void *);
+void __slab_flush(lwt_kthd_t);
+void __slab_exit(lwt_kthd_t);
+
+#endif /* LWT_SLAB_H_ */
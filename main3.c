@@ -1,10 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
 
 #include "lwt.h"
 #include "lwt_chan.h"
 #include "lwt_cgrp.h"
+#include "lwt_select.h"
+#include "lwt_bcast.h"
+#include "lwt_chan_stats.h"
+#include "lwt_call.h"
+#include "lwt_pipeline.h"
+#include "lwt_slab.h"
 
 #define rdtscll(val) __asm__ __volatile__("rdtsc" : "=A" (val))
 
@@ -222,6 +231,48 @@ test_perf_channels(int chsz)
 	lwt_join(t);
 }
 
+void *
+fn_call_srv(lwt_chan_t to)
+{
+	lwt_chan_t srv;
+	lwt_call_t call;
+	int i;
+
+	srv = lwt_chan(0);
+	lwt_snd_chan(to, srv);
+	for (i = 0 ; i < ITER ; i++) {
+		call = lwt_rcv_call(srv);
+		lwt_reply(call, (void*)((int)lwt_call_req(call) + 1));
+	}
+	lwt_chan_deref(srv);
+	lwt_chan_deref(to);
+
+	return NULL;
+}
+
+void
+test_perf_call(void)
+{
+	lwt_chan_t from, srv;
+	lwt_t t;
+	int i;
+	unsigned long long start, end;
+
+	from = lwt_chan(0);
+	assert(from);
+	t    = lwt_create_chan(fn_call_srv, from, 0);
+	srv  = lwt_rcv_chan(from);
+	rdtscll(start);
+	for (i = 0 ; i < ITER ; i++) {
+		assert(i + 1 == (int)lwt_call(srv, (void*)i));
+	}
+	rdtscll(end);
+	printf("[PERF] %5lld <- call+reply\n", (end-start)/(ITER*2));
+	lwt_chan_deref(srv);
+	lwt_join(t);
+	lwt_chan_deref(from);
+}
+
 static int sndrcv_cnt = 0;
 
 void *
@@ -319,6 +370,649 @@ test_perf_async_steam(int chsz)
 	lwt_join(t);
 }
 
+void
+test_perf_spsc_steam(int chsz)
+{
+	lwt_chan_t from;
+	lwt_t t;
+	int i;
+	unsigned long long start, end;
+
+	from = lwt_chan_spsc(chsz);
+	assert(from);
+	t = lwt_create_chan(fn_async_steam, from, 0);
+	assert(from->snd_cnt == 1);
+	rdtscll(start);
+	for (i = 0 ; i < ITER ; i++) {
+		assert(i+1 == (int)lwt_rcv(from));
+	}
+	rdtscll(end);
+	printf("[PERF] %5lld <- spsc snd->rcv (buffer size %d)\n",
+	       (end-start)/(ITER*2), chsz);
+	lwt_chan_deref(from);
+	lwt_join(t);
+}
+
+#define BATCH 32
+
+void *
+fn_batch_steam(lwt_chan_t to)
+{
+	void *items[BATCH];
+	int i, j, sent;
+
+	for (i = 0 ; i < ITER ; i += sent) {
+		for (j = 0 ; j < BATCH && i+j < ITER ; j++) items[j] = (void*)(i+j+1);
+		sent = lwt_snd_n(to, items, j);
+		assert(sent > 0);
+	}
+	lwt_chan_deref(to);
+
+	return NULL;
+}
+
+void
+test_perf_batch_steam(int chsz)
+{
+	lwt_chan_t from;
+	lwt_t t;
+	void *items[BATCH];
+	int i, j, n;
+	unsigned long long start, end;
+
+	from = lwt_chan(chsz);
+	assert(from);
+	t = lwt_create_chan(fn_batch_steam, from, 0);
+	rdtscll(start);
+	for (i = 0 ; i < ITER ; i += n) {
+		n = lwt_rcv_n(from, items, BATCH);
+		assert(n > 0);
+		for (j = 0 ; j < n ; j++) assert(i+j+1 == (int)items[j]);
+	}
+	rdtscll(end);
+	printf("[PERF] %5lld <- batched snd->rcv (buffer size %d, batch %d)\n",
+	       (end-start)/(ITER*2), chsz, BATCH);
+	lwt_chan_deref(from);
+	lwt_join(t);
+}
+
+struct steam_msg {
+	int seq;
+	long payload[3];
+};
+
+void *
+fn_typed_steam(lwt_chan_t to)
+{
+	struct steam_msg msg;
+	int i;
+
+	for (i = 0 ; i < ITER ; i++) {
+		msg.seq = i+1;
+		msg.payload[0] = msg.payload[2] = -i;
+		msg.payload[1] = 0;
+		lwt_snd_msg(to, &msg);
+	}
+	lwt_chan_deref(to);
+
+	return NULL;
+}
+
+void
+test_perf_typed_steam(int chsz)
+{
+	lwt_chan_t from;
+	lwt_t t;
+	struct steam_msg msg;
+	int i;
+	unsigned long long start, end;
+
+	from = lwt_chan_typed(sizeof(struct steam_msg), chsz);
+	assert(from);
+	t = lwt_create_chan(fn_typed_steam, from, 0);
+	rdtscll(start);
+	for (i = 0 ; i < ITER ; i++) {
+		lwt_rcv_msg(from, &msg);
+		assert(msg.seq == i+1 && msg.payload[0] == -i && msg.payload[2] == -i && !msg.payload[1]);
+	}
+	rdtscll(end);
+	printf("[PERF] %5lld <- typed snd->rcv (buffer size %d, message size %d)\n",
+	       (end-start)/(ITER*2), chsz, (int)sizeof(struct steam_msg));
+	lwt_chan_deref(from);
+	lwt_join(t);
+}
+
+void *
+fn_try_snd(lwt_chan_t c)
+{
+	assert(!lwt_snd(c, (void*)1));
+	lwt_chan_deref(c);
+
+	return NULL;
+}
+
+void
+test_try(int chsz)
+{
+	lwt_chan_t c;
+	lwt_t t;
+	void *data;
+	int i;
+
+	printf("[TEST] try send/receive (channel buffer size %d)\n", chsz);
+	c = lwt_chan(chsz);
+	assert(c);
+	assert(lwt_chan_pending(c) == 0);
+	assert(lwt_rcv_try(c, &data) == -1);
+	if (chsz > 0) {
+		/* the buffer is rounded up to a power of two and takes exactly that many */
+		chsz = c->buffer_size;
+		assert(chsz && !(chsz & (chsz - 1)));
+		/* fill the buffer without blocking; the last one doesn't fit */
+		for (i = 0 ; i < chsz ; i++) assert(!lwt_snd_try(c, (void*)(i+1)));
+		assert(lwt_snd_try(c, (void*)(i+1)) == -1);
+		assert(lwt_chan_pending(c) == chsz);
+		for (i = 0 ; i < chsz ; i++) {
+			assert(!lwt_rcv_try(c, &data));
+			assert(data == (void*)(i+1));
+		}
+		assert(lwt_chan_pending(c) == 0);
+	} else {
+		/* nobody is receiving */
+		assert(lwt_snd_try(c, (void*)1) == -1);
+	}
+	t = lwt_create_chan(fn_try_snd, c, 0);
+	/* let the sender post its data */
+	lwt_yield(LWT_NULL);
+	assert(lwt_chan_pending(c) == 1);
+	assert(!lwt_rcv_try(c, &data));
+	assert(data == (void*)1);
+	assert(lwt_rcv_try(c, &data) == -1);
+	lwt_join(t);
+	lwt_chan_deref(c);
+}
+
+void *
+fn_select_snd(lwt_chan_t c)
+{
+	struct lwt_select_case cases[2];
+	lwt_chan_t ctl, c2;
+	int i, r;
+
+	/* ask for the second channel */
+	ctl = lwt_chan(0);
+	lwt_snd_chan(c, ctl);
+	c2 = lwt_rcv_chan(ctl);
+	for (i = 1 ; i <= ITER ; i++) {
+		cases[0].channel = c;
+		cases[0].op = LWT_SELECT_SND;
+		cases[0].data = (void*)i;
+		cases[1].channel = c2;
+		cases[1].op = LWT_SELECT_SND;
+		cases[1].data = (void*)i;
+		r = lwt_select(cases, 2, -1);
+		assert(r == 0 || r == 1);
+	}
+	lwt_chan_deref(c);
+	lwt_chan_deref(c2);
+	lwt_chan_deref(ctl);
+
+	return NULL;
+}
+
+void
+test_select(int chsz)
+{
+	struct lwt_select_case cases[2];
+	lwt_chan_t cs[2], ctl;
+	lwt_t t;
+	int i, r, last[2] = {0, 0}, cnt[2] = {0, 0};
+
+	printf("[TEST] select (channel buffer size %d)\n", chsz);
+	cs[0] = lwt_chan(chsz);
+	cs[1] = lwt_chan(chsz);
+	for (i = 0 ; i < 2 ; i++) {
+		cases[i].channel = cs[i];
+		cases[i].op = LWT_SELECT_RCV;
+	}
+	/* nothing to receive yet */
+	assert(lwt_select(cases, 2, 0) == -1);
+	assert(lwt_select(cases, 2, 100) == -1);
+	t = lwt_create_chan(fn_select_snd, cs[0], 0);
+	ctl = lwt_rcv_chan(cs[0]);
+	lwt_snd_chan(ctl, cs[1]);
+	lwt_chan_deref(ctl);
+	for (i = 0 ; i < ITER ; i++) {
+		/* a long timeout parks on the timer as well as the cases */
+		r = lwt_select(cases, 2, (i & 1) ? -1 : 10000000);
+		assert(r == 0 || r == 1);
+		/* each channel stays in order */
+		assert((int)cases[r].data > last[r]);
+		last[r] = (int)cases[r].data;
+		cnt[r]++;
+	}
+	assert(cnt[0] + cnt[1] == ITER);
+	assert(last[0] == ITER || last[1] == ITER);
+	lwt_join(t);
+	lwt_chan_deref(cs[0]);
+	lwt_chan_deref(cs[1]);
+}
+
+#define MPMC_WORKERS 3
+#define MPMC_DONE ((void*)-1)
+
+int mpmc_sum, mpmc_cnt;
+
+void *
+fn_mpmc_worker(lwt_chan_t w)
+{
+	void *d;
+	int cnt = 0;
+
+	while ((d = lwt_rcv(w)) != MPMC_DONE) {
+		mpmc_sum += (int)d;
+		cnt++;
+		/* let the other workers pull */
+		if ((cnt % 7) == 0) lwt_yield(LWT_NULL);
+	}
+	mpmc_cnt += cnt;
+	lwt_chan_deref(w);
+
+	return NULL;
+}
+
+void
+test_mpmc(int chsz)
+{
+	lwt_chan_t w;
+	lwt_t ts[MPMC_WORKERS];
+	int i;
+
+	printf("[TEST] multi-consumer channel (buffer size %d, %d workers)\n",
+	       chsz, MPMC_WORKERS);
+	mpmc_sum = mpmc_cnt = 0;
+	w = lwt_chan_mpmc(chsz);
+	assert(w);
+	for (i = 0 ; i < MPMC_WORKERS ; i++) {
+		ts[i] = lwt_create_chan(fn_mpmc_worker, w, 0);
+	}
+	for (i = 1 ; i <= ITER ; i++) lwt_snd(w, (void*)i);
+	for (i = 0 ; i < MPMC_WORKERS ; i++) lwt_snd(w, MPMC_DONE);
+	for (i = 0 ; i < MPMC_WORKERS ; i++) lwt_join(ts[i]);
+	assert(mpmc_cnt == ITER);
+	assert(mpmc_sum == ITER * (ITER + 1) / 2);
+	assert(lwt_chan_pending(w) == 0);
+	lwt_chan_deref(w);
+}
+
+void *
+fn_grow_snder(lwt_chan_t c)
+{
+	int i;
+
+	for (i = 1 ; i <= ITER ; i++) lwt_snd(c, (void*)i);
+	lwt_chan_deref(c);
+
+	return NULL;
+}
+
+void
+test_grow(int chsz, int maxsz)
+{
+	lwt_chan_t c;
+	lwt_t t;
+	int i;
+
+	printf("[TEST] growable channel (buffer size %d, up to %d)\n", chsz, maxsz);
+	c = lwt_chan_grow(chsz, maxsz);
+	assert(c);
+	t = lwt_create_chan(fn_grow_snder, c, 0);
+	lwt_yield(LWT_NULL);
+	/* the whole burst fits without the sender blocking */
+	if (maxsz >= ITER) assert(lwt_chan_pending(c) == ITER);
+	for (i = 1 ; i <= ITER ; i++) assert((int)lwt_rcv(c) == i);
+	lwt_join(t);
+	/* mostly empty from here on; the buffer halves back down */
+	for (i = 0 ; i < ITER * 4 ; i++) {
+		lwt_snd(c, (void*)1);
+		assert((int)lwt_rcv(c) == 1);
+	}
+	assert(!c->async_ring->next);
+	assert(c->async_ring->capacity < 2 * (unsigned int)chsz);
+	lwt_chan_deref(c);
+}
+
+void
+test_chan_stats(int chsz)
+{
+	lwt_chan_t c;
+	lwt_t t;
+	struct lwt_chan_stats st;
+	int i;
+
+	printf("[TEST] channel statistics (buffer size %d)\n", chsz);
+	c = lwt_chan(chsz);
+	assert(c);
+	lwt_chan_mark_set(c, (void*)0x57a75);
+	t = lwt_create_chan(fn_grow_snder, c, 0);
+	for (i = 1 ; i <= ITER ; i++) assert((int)lwt_rcv(c) == i);
+	lwt_join(t);
+	/* only kept when built with LWT_CHAN_STATS */
+	if (!lwt_chan_stats(c, &st)) {
+		assert(st.num_snds == ITER && st.num_rcvs == ITER);
+		/* the sender outruns the buffer */
+		assert(st.num_snd_blocks > 0);
+		/* occupancy is only sampled for buffered channels */
+		if (chsz) assert(st.peak_entries > 0 && st.peak_entries <= (unsigned long)chsz);
+		else assert(st.peak_entries == 0);
+		lwt_chan_stats_dump(3);
+	}
+	lwt_chan_deref(c);
+}
+
+#define REFS_CHANS 4
+
+void *
+fn_refs_snder(lwt_chan_t c)
+{
+	lwt_chan_t in, out[REFS_CHANS];
+	int i;
+
+	in = lwt_chan(0);
+	lwt_snd_chan(c, in);
+	/* holds sender rights on every channel handed over at once */
+	for (i = 0 ; i < REFS_CHANS ; i++) {
+		out[i] = lwt_rcv_chan(in);
+		lwt_snd(out[i], (void*)(i + 1));
+	}
+	lwt_rcv(in);
+	for (i = 0 ; i < REFS_CHANS ; i++) lwt_chan_deref(out[i]);
+	lwt_chan_deref(in);
+	lwt_chan_deref(c);
+
+	return NULL;
+}
+
+void
+test_chan_refs(void)
+{
+	lwt_chan_t c, in, chans[REFS_CHANS];
+	lwt_t t;
+	int i;
+
+	printf("[TEST] channel references\n");
+	c = lwt_chan(0);
+	t = lwt_create_chan(fn_refs_snder, c, 0);
+	in = lwt_rcv_chan(c);
+	assert(in->snd_cnt == 1 && in->ref_cnt == 2);
+	for (i = 0 ; i < REFS_CHANS ; i++) {
+		chans[i] = lwt_chan(1);
+		lwt_snd_chan(in, chans[i]);
+		assert(chans[i]->snd_cnt == 1 && chans[i]->ref_cnt == 2);
+	}
+	for (i = 0 ; i < REFS_CHANS ; i++) {
+		assert((int)lwt_rcv(chans[i]) == i + 1);
+		/* every other channel loses its receiver first; the sender's deref frees it */
+		if (i % 2) lwt_chan_deref(chans[i]);
+	}
+	lwt_snd(in, (void*)1);
+	lwt_chan_deref(in);
+	lwt_join(t);
+	for (i = 0 ; i < REFS_CHANS ; i += 2) {
+		assert(chans[i]->snd_cnt == 0 && chans[i]->ref_cnt == 1);
+		lwt_chan_deref(chans[i]);
+	}
+	assert(c->snd_cnt == 0);
+	lwt_chan_deref(c);
+}
+
+void
+test_chan_reuse(int chsz)
+{
+	lwt_chan_t c, d;
+	int i;
+
+	printf("[TEST] channel reuse (buffer size %d)\n", chsz);
+	c = lwt_chan(chsz);
+	lwt_chan_deref(c);
+	/* freed channels go back to the kthd's cache and are handed out again */
+	for (i = 0 ; i < ITER ; i++) {
+		d = lwt_chan(chsz);
+		assert(d == c);
+		lwt_chan_deref(d);
+	}
+}
+
+#define PIPE_CAP 8
+
+void *pipe_double(void *d, void *arg) { return (void*)((int)d * 2); }
+void *pipe_filter(void *d, void *arg) { return ((int)d % 3) ? d : NULL; }
+void *pipe_add(void *d, void *arg) { return (void*)((int)d + (int)arg); }
+
+void *
+fn_pipe_feed(void *d)
+{
+	int i;
+
+	for (i = 1 ; i <= ITER ; i++) assert(!lwt_pipeline_snd((lwt_pipeline_t)d, (void*)i));
+
+	return NULL;
+}
+
+void
+test_pipeline(void)
+{
+	lwt_pipeline_t p;
+	struct lwt_stage_stats stats;
+	lwt_t t;
+	void *m;
+	int i, cnt = 0, exp_cnt = 0;
+	long long sum = 0, exp_sum = 0;
+
+	printf("[TEST] pipeline (3 local stages, queue size %d)\n", PIPE_CAP);
+	for (i = 1 ; i <= ITER ; i++) {
+		if ((i * 2) % 3) {
+			exp_cnt++;
+			exp_sum += i * 2 + 1;
+		}
+	}
+	p = lwt_pipeline(PIPE_CAP);
+	assert(p);
+	assert(lwt_pipeline_stage(p, pipe_double, NULL, 1, LWT_STAGE_LOCAL, PIPE_CAP) == 0);
+	assert(lwt_pipeline_stage(p, pipe_filter, NULL, 2, LWT_STAGE_LOCAL, PIPE_CAP) == 1);
+	assert(lwt_pipeline_stage(p, pipe_add, (void*)1, 1, LWT_STAGE_LOCAL, PIPE_CAP) == 2);
+	assert(!lwt_pipeline_start(p));
+	/* the queues are smaller than the stream, so the feeder keeps getting blocked */
+	t = lwt_create(fn_pipe_feed, p, 0);
+	while (cnt < exp_cnt) {
+		m = lwt_pipeline_rcv(p);
+		assert(m);
+		sum += (int)m;
+		cnt++;
+		assert(!lwt_pipeline_stats(p, 0, &stats));
+		assert(stats.depth <= PIPE_CAP && stats.num_workers == 1);
+	}
+	lwt_join(t);
+	assert(sum == exp_sum);
+	assert(lwt_pipeline_free(p) == -1);
+	lwt_pipeline_stop(p);
+	assert(!lwt_pipeline_rcv(p));
+	for (i = 0 ; i < 3 ; i++) {
+		assert(!lwt_pipeline_stats(p, i, &stats));
+		assert(stats.num_workers == 0);
+		assert(stats.num_items == (unsigned int)(i < 2 ? ITER : exp_cnt));
+	}
+	assert(lwt_pipeline_stats(p, 3, &stats) == -1);
+	assert(!lwt_pipeline_free(p));
+}
+
+void
+test_malloc(void)
+{
+	static int sizes[] = {1, 32, 33, 100, 512, 4096, 4097, 100000};
+	char *mem[8], *again;
+	int i, j;
+
+	printf("[TEST] lwt_malloc size classes\n");
+	for (i = 0 ; i < 8 ; i++) {
+		mem[i] = lwt_malloc(sizes[i]);
+		assert(mem[i]);
+		assert(((unsigned long)mem[i] & (sizeof(long) - 1)) == 0);
+		for (j = 0 ; j < sizes[i] ; j++) mem[i][j] = (char)i;
+	}
+	for (i = 0 ; i < 8 ; i++) {
+		for (j = 0 ; j < sizes[i] ; j++) assert(mem[i][j] == (char)i);
+	}
+	/* freed memory goes back to its class and is handed out again */
+	for (i = 0 ; i < 8 ; i++) {
+		lwt_free(mem[i]);
+		if (sizes[i] > 4096) continue;
+		again = lwt_malloc(sizes[i]);
+		assert(again == mem[i]);
+		lwt_free(again);
+	}
+	lwt_free(NULL);
+}
+
+#define BCAST_SUBS 3
+#define BCAST_DONE ((void*)-1)
+
+int bcast_subs, bcast_rcvd[BCAST_SUBS];
+lwt_bcast_policy_t bcast_policy;
+
+void *
+fn_bcast_sub(void *d)
+{
+	lwt_bcast_sub_t s;
+	void *m;
+	int id, last = 0, cnt = 0;
+
+	s = lwt_bcast_sub((lwt_bcast_t)d);
+	assert(s);
+	id = bcast_subs++;
+	while ((m = lwt_bcast_rcv(s)) != BCAST_DONE) {
+		if (bcast_policy == LWT_BCAST_BLOCK) assert((int)m == last + 1);
+		else assert((int)m > last);
+		last = (int)m;
+		cnt++;
+		/* the first subscriber lags behind */
+		if (id == 0 && (cnt % 3) == 0) lwt_yield(LWT_NULL);
+	}
+	assert(cnt + lwt_bcast_dropped(s) == ITER);
+	bcast_rcvd[id] = cnt;
+	lwt_bcast_unsub(s);
+
+	return NULL;
+}
+
+void
+test_bcast(lwt_bcast_policy_t policy, int chsz)
+{
+	lwt_bcast_t b;
+	lwt_t ts[BCAST_SUBS];
+	void *batch[8];
+	int i, j;
+
+	printf("[TEST] broadcast channel (%s, buffer size %d, %d subscribers)\n",
+	       policy == LWT_BCAST_BLOCK ? "block" : "drop oldest", chsz, BCAST_SUBS);
+	bcast_subs = 0;
+	bcast_policy = policy;
+	b = lwt_chan_bcast(chsz, BCAST_SUBS, policy);
+	assert(b);
+	for (i = 0 ; i < BCAST_SUBS ; i++) {
+		ts[i] = lwt_create(fn_bcast_sub, b, 0);
+	}
+	while (bcast_subs < BCAST_SUBS) lwt_yield(LWT_NULL);
+	assert(!lwt_bcast_sub(b));
+	for (i = 1 ; i <= ITER ; i += 8) {
+		for (j = 0 ; j < 8 ; j++) batch[j] = (void*)(i + j);
+		lwt_bcast_snd_n(b, batch, 8);
+	}
+	lwt_bcast_snd(b, BCAST_DONE);
+	for (i = 0 ; i < BCAST_SUBS ; i++) lwt_join(ts[i]);
+	for (i = 0 ; i < BCAST_SUBS ; i++) {
+		if (policy == LWT_BCAST_BLOCK) assert(bcast_rcvd[i] == ITER);
+		else assert(bcast_rcvd[i] > 0);
+	}
+	assert(!lwt_bcast_free(b));
+}
+
+void *
+fn_watch_writer(void *d)
+{
+	int i;
+
+	for (i = 0 ; i < 3 ; i++) lwt_yield(LWT_NULL);
+	assert(write((int)d, "y", 1) == 1);
+
+	return NULL;
+}
+
+void
+test_cgrp_watch(void)
+{
+	lwt_cgrp_t g;
+	struct lwt_select_case sc;
+	lwt_chan_t c, fc, tc;
+	lwt_t t;
+	int fds[2], watch_events;
+	char buf[8];
+
+	printf("[TEST] group wait on a channel, a pipe and a timer\n");
+	watch_events = lwt_info(LWT_INFO_KTHD_WATCH_EVENTS);
+	assert(!pipe(fds));
+	assert(!fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK));
+	assert(!fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK));
+	g = lwt_cgrp();
+	assert(g);
+	c = lwt_chan(1);
+	assert(!lwt_cgrp_add(g, c));
+	fc = lwt_cgrp_add_fd(g, fds[0], EPOLLIN);
+	assert(fc);
+	/* readable before anyone waits */
+	assert(write(fds[1], "x", 1) == 1);
+	assert(lwt_cgrp_wait(g) == fc);
+	assert((int)lwt_rcv(fc) & EPOLLIN);
+	assert(read(fds[0], buf, sizeof(buf)) == 1);
+	assert(read(fds[0], buf, sizeof(buf)) == -1);
+	/* written while the waiter is parked */
+	t = lwt_create(fn_watch_writer, (void*)fds[1], 0);
+	assert(lwt_cgrp_wait(g) == fc);
+	assert((int)lwt_rcv(fc) & EPOLLIN);
+	assert(read(fds[0], buf, sizeof(buf)) == 1 && buf[0] == 'y');
+	lwt_join(t);
+	/* an edge while a readiness is pending is folded into it */
+	assert(write(fds[1], "a", 1) == 1);
+	assert(lwt_cgrp_wait(g) == fc);
+	assert(write(fds[1], "b", 1) == 1);
+	/* park for a bit so the kthd looks at the descriptor again */
+	sc.channel = c;
+	sc.op = LWT_SELECT_RCV;
+	assert(lwt_select(&sc, 1, 2000) == -1);
+	assert(lwt_chan_pending(fc) == 1);
+	assert((int)lwt_rcv(fc) & EPOLLIN);
+	assert(read(fds[0], buf, sizeof(buf)) == 2);
+	/* nothing else can wake the kthd while it sleeps in epoll */
+	tc = lwt_cgrp_add_timer(g, 1000000);
+	assert(tc);
+	assert(lwt_cgrp_wait(g) == tc);
+	assert((int)lwt_rcv(tc) == 1);
+	lwt_snd(c, (void*)1);
+	assert(lwt_cgrp_wait(g) == c);
+	assert((int)lwt_rcv(c) == 1);
+	/* the pipe three times and two timers; the folded edge isn't counted */
+	assert(lwt_info(LWT_INFO_KTHD_WATCH_EVENTS) - watch_events == 5);
+	assert(!lwt_cgrp_rem(g, tc));
+	assert(!lwt_cgrp_rem(g, fc));
+	assert(!lwt_cgrp_rem(g, c));
+	lwt_chan_deref(tc);
+	lwt_chan_deref(fc);
+	lwt_chan_deref(c);
+	assert(!lwt_cgrp_free(g));
+	close(fds[0]);
+	close(fds[1]);
+}
+
 void *
 fn_grpwait(lwt_chan_t c)
 {
@@ -358,14 +1052,7 @@ test_grpwait(int chsz, int grpsz)
 		lwt_cgrp_add(g, cs[i]);
 	}
 	//assert(lwt_cgrp_free(g) == -1);
-	/**
-	 * Q: why don't we iterate through all of the data here?
-	 * 
-	 * A: We need to fix 1) cevt_wait to be level triggered, or 2)
-	 * provide a function to detect if there is data available on
-	 * a channel.  Either of these would allows us to iterate on a
-	 * channel while there is more data pending.
-	 */
+	/* edge-triggered: one receive per wait; test_grpwait_level drains */
 	//for (i = 0 ; i < ((ITER * grpsz)-(grpsz*chsz)); i++) {
 	for(i = 0; i < ITER * grpsz; i++){
 		lwt_chan_t c;
@@ -385,17 +1072,95 @@ test_grpwait(int chsz, int grpsz)
 	return;
 }
 
+void
+test_grpwait_level(int chsz, int grpsz)
+{
+	lwt_chan_t cs[grpsz], ready[grpsz];
+	lwt_t ts[grpsz];
+	int i, j, n, got, wakeups = 0, max_n = 0;
+	lwt_cgrp_t g;
+
+	printf("[TEST] level-triggered group wait (channel buffer size %d, grpsz %d)\n",
+	       chsz, grpsz);
+	g = lwt_cgrp();
+	assert(g);
+	assert(!lwt_cgrp_trigger(g, LWT_CGRP_LEVEL));
+
+	for (i = 0 ; i < grpsz ; i++) {
+		cs[i] = lwt_chan(chsz);
+		assert(cs[i]);
+		ts[i] = lwt_create_chan(fn_grpwait, cs[i], 0);
+		lwt_chan_mark_set(cs[i], (void*)lwt_id(ts[i]));
+		lwt_cgrp_add(g, cs[i]);
+	}
+	/* let every sender post before the first wait */
+	for (i = 0 ; i < grpsz ; i++) lwt_yield(LWT_NULL);
+	/* drain every ready channel before waiting again */
+	for (i = 0 ; i < ITER * grpsz ; ) {
+		n = lwt_cgrp_wait_n(g, ready, grpsz);
+		assert(n > 0 && n <= grpsz);
+		wakeups++;
+		if (n > max_n) max_n = n;
+		for (j = 0 ; j < n ; j++) {
+			void *r;
+
+			got = 0;
+			while (!lwt_rcv_try(ready[j], &r)) {
+				assert((int)r == (int)lwt_chan_mark_get(ready[j]));
+				got++;
+			}
+			/* a channel is only reported while it has something */
+			assert(got > 0);
+			i += got;
+		}
+	}
+	/* the first wait found every channel ready and has to report them all at once */
+	assert(max_n == grpsz);
+	assert(wakeups < ITER * grpsz);
+	for (i = 0 ; i < grpsz ; i++) {
+		lwt_join(ts[i]);
+		assert(!lwt_cgrp_rem(g, cs[i]));
+		lwt_chan_deref(cs[i]);
+	}
+	assert(!lwt_cgrp_free(g));
+}
+
 int
 main(void)
 {
 	test_perf();
 	test_perf_channels(0);
+	test_perf_call();
 	test_perf_async_steam(ITER/10 < 100 ? ITER/10 : 100);
+	test_perf_spsc_steam(ITER/10 < 100 ? ITER/10 : 100);
+	test_perf_batch_steam(ITER/10 < 100 ? ITER/10 : 100);
+	test_perf_typed_steam(ITER/10 < 100 ? ITER/10 : 100);
 	test_crt_join_sched();
 	test_multisend(0);
 	test_multisend(ITER/10 < 100 ? ITER/10 : 100);
+	test_try(0);
+	test_try(3);
+	test_try(4);
+	test_select(0);
+	test_select(4);
+	test_mpmc(1);
+	test_mpmc(16);
+	test_grow(2, ITER);
+	test_grow(4, 16);
+	test_chan_stats(0);
+	test_chan_stats(4);
+	test_chan_refs();
+	test_chan_reuse(0);
+	test_chan_reuse(2);
+	test_pipeline();
+	test_malloc();
+	test_bcast(LWT_BCAST_BLOCK, 16);
+	test_bcast(LWT_BCAST_DROP_OLDEST, 16);
 	test_grpwait(0, 3);
 	test_grpwait(3, 3);
+	test_grpwait_level(0, 3);
+	test_grpwait_level(3, 3);
+	test_cgrp_watch();
 
 	return 0;
 }
@@ -6,11 +6,21 @@
  */
 #include "lwt_kthd.h"
 #include "lwt_chan.h"
+#include "lwt_cgrp.h"
+#include "lwt_buf.h"
+#include "lwt_select.h"
+#include "lwt_bcast.h"
+#include "lwt_call.h"
+#include "lwt_pipeline.h"
+#include "lwt_slab.h"
 #include "lwt.h"
+#include "faa.h"
 
 #include "stdio.h"
 #include "assert.h"
 
+#define rdtscll(val) __asm__ __volatile__("rdtsc" : "=A" (val))
+
 #define MAX_PING_PONG_VALUE 100
 
 #define ITER 10000
@@ -64,6 +74,537 @@ fn_grpwait(lwt_chan_t c)
 
 #define GRPSZ 3
 
+void *
+fn_kthd_steam(lwt_chan_t to)
+{
+	int i;
+
+	for (i = 0 ; i < ITER ; i++) lwt_snd(to, (void*)(i+1));
+	lwt_chan_deref(to);
+
+	return NULL;
+}
+
+void
+test_perf_kthd_steam(int chsz, int spsc)
+{
+	lwt_chan_t from;
+	int i;
+	unsigned long long start, end;
+
+	from = spsc ? lwt_chan_spsc(chsz) : lwt_chan(chsz);
+	assert(from);
+	assert(!lwt_kthd_create(fn_kthd_steam, from, LWT_NOJOIN));
+	rdtscll(start);
+	for (i = 0 ; i < ITER ; i++) {
+		assert(i+1 == (int)lwt_rcv(from));
+	}
+	rdtscll(end);
+	printf("[PERF] %5lld <- cross-kthd %s snd->rcv (buffer size %d)\n",
+	       (end-start)/ITER, spsc ? "spsc" : "chan", chsz);
+	lwt_chan_deref(from);
+}
+
+#define NUM_BUFS 4
+#define BUF_SZ 4096
+
+void *
+fn_kthd_bufs(lwt_chan_t back)
+{
+	lwt_chan_t from;
+	lwt_buf_t buf;
+	int i;
+
+	from = lwt_chan(NUM_BUFS);
+	assert(from);
+	lwt_snd_chan(back, from);
+	lwt_chan_deref(back);
+	for (i = 0 ; i < ITER ; i++) {
+		buf = lwt_rcv_buf(from);
+		assert(buf->len == sizeof(int) && *(int *)buf->data == i);
+		assert(((char *)buf->data)[BUF_SZ-1] == (char)i);
+		/* hands the buffer back to the pool on the main kthd */
+		lwt_buf_release(buf);
+	}
+	lwt_chan_deref(from);
+
+	return NULL;
+}
+
+void
+test_kthd_bufs(void)
+{
+	lwt_buf_pool_t pool;
+	lwt_buf_t bufs[NUM_BUFS];
+	lwt_chan_t back, to;
+	int i;
+
+	printf("[TEST] cross-kthd buffer lending (%d buffers)\n", NUM_BUFS);
+	pool = lwt_buf_pool(BUF_SZ, NUM_BUFS);
+	assert(pool);
+	back = lwt_chan(0);
+	assert(!lwt_kthd_create(fn_kthd_bufs, back, LWT_NOJOIN));
+	to = lwt_rcv_chan(back);
+	for (i = 0 ; i < ITER ; i++) {
+		lwt_buf_t buf = lwt_buf_alloc(pool);
+		assert(buf->ref_cnt == 1 && buf->size == BUF_SZ);
+		*(int *)buf->data = i;
+		((char *)buf->data)[BUF_SZ-1] = (char)i;
+		buf->len = sizeof(int);
+		lwt_snd_buf(to, buf);
+	}
+	lwt_chan_deref(to);
+	/* every buffer has to find its way back */
+	for (i = 0 ; i < NUM_BUFS ; i++) bufs[i] = lwt_buf_alloc(pool);
+	assert(lwt_buf_pool_free(pool) == -1);
+	for (i = 0 ; i < NUM_BUFS ; i++) lwt_buf_release(bufs[i]);
+	assert(!lwt_buf_pool_free(pool));
+	lwt_chan_deref(back);
+}
+
+void *
+fn_kthd_select(lwt_chan_t c)
+{
+	struct lwt_select_case cases[2];
+	lwt_chan_t ctl, c2;
+	int i;
+
+	/* ask for the second channel */
+	ctl = lwt_chan(0);
+	lwt_snd_chan(c, ctl);
+	c2 = lwt_rcv_chan(ctl);
+	for (i = 1 ; i <= ITER ; i++) {
+		cases[0].channel = c;
+		cases[0].op = LWT_SELECT_SND;
+		cases[0].data = (void*)i;
+		cases[1].channel = c2;
+		cases[1].op = LWT_SELECT_SND;
+		cases[1].data = (void*)i;
+		/* parks on both channels of the other kthd */
+		assert(lwt_select(cases, 2, -1) >= 0);
+	}
+	lwt_chan_deref(c);
+	lwt_chan_deref(c2);
+	lwt_chan_deref(ctl);
+
+	return NULL;
+}
+
+void
+test_kthd_select(int chsz)
+{
+	struct lwt_select_case cases[2];
+	lwt_chan_t cs[2], ctl;
+	int i, r, last[2] = {0, 0};
+
+	printf("[TEST] cross-kthd select (channel buffer size %d)\n", chsz);
+	cs[0] = lwt_chan(chsz);
+	cs[1] = lwt_chan(chsz);
+	for (i = 0 ; i < 2 ; i++) {
+		cases[i].channel = cs[i];
+		cases[i].op = LWT_SELECT_RCV;
+	}
+	assert(!lwt_kthd_create(fn_kthd_select, cs[0], LWT_NOJOIN));
+	ctl = lwt_rcv_chan(cs[0]);
+	lwt_snd_chan(ctl, cs[1]);
+	lwt_chan_deref(ctl);
+	for (i = 0 ; i < ITER ; i++) {
+		r = lwt_select(cases, 2, -1);
+		assert(r == 0 || r == 1);
+		assert((int)cases[r].data > last[r]);
+		last[r] = (int)cases[r].data;
+	}
+	assert(last[0] == ITER || last[1] == ITER);
+	lwt_chan_deref(cs[0]);
+	lwt_chan_deref(cs[1]);
+}
+
+#define CALL_CALLERS 3
+
+void *
+fn_kthd_call_srv(lwt_chan_t to)
+{
+	lwt_chan_t srv;
+	lwt_call_t call;
+	int i;
+
+	srv = lwt_chan(CALL_CALLERS);
+	lwt_snd_chan(to, srv);
+	lwt_chan_deref(to);
+	for (i = 0 ; i < CALL_CALLERS * ITER ; i++) {
+		call = lwt_rcv_call(srv);
+		lwt_reply(call, (void*)((int)lwt_call_req(call) + 1));
+	}
+	lwt_chan_deref(srv);
+
+	return NULL;
+}
+
+void *
+fn_kthd_caller(void *d)
+{
+	int i, base = (int)lwt_id(lwt_current()) * ITER * 2;
+
+	/* replies have to come back to the lwt that asked */
+	for (i = 0 ; i < ITER ; i++) {
+		assert(base + i + 1 == (int)lwt_call((lwt_chan_t)d, (void*)(base + i)));
+	}
+
+	return NULL;
+}
+
+void
+test_kthd_call(void)
+{
+	lwt_chan_t from, srv;
+	lwt_t t[CALL_CALLERS];
+	int i;
+
+	printf("[TEST] cross-kthd call (%d callers)\n", CALL_CALLERS);
+	from = lwt_chan(0);
+	assert(!lwt_kthd_create(fn_kthd_call_srv, from, LWT_NOJOIN));
+	srv = lwt_rcv_chan(from);
+	for (i = 0 ; i < CALL_CALLERS ; i++) t[i] = lwt_create(fn_kthd_caller, srv, 0);
+	for (i = 0 ; i < CALL_CALLERS ; i++) lwt_join(t[i]);
+	lwt_chan_deref(srv);
+	lwt_chan_deref(from);
+}
+
+#define PIPE_CAP 4
+
+void *pipe_add(void *d, void *arg) { return (void*)((int)d + (int)arg); }
+
+void *
+fn_kthd_pipe_feed(void *d)
+{
+	int i;
+
+	for (i = 1 ; i <= ITER ; i++) lwt_pipeline_snd((lwt_pipeline_t)d, (void*)i);
+
+	return NULL;
+}
+
+void
+test_kthd_pipeline(void)
+{
+	lwt_pipeline_t p;
+	struct lwt_stage_stats stats;
+	lwt_t t;
+	void *m;
+	int i;
+	long long sum = 0;
+
+	printf("[TEST] cross-kthd pipeline (queue size %d)\n", PIPE_CAP);
+	p = lwt_pipeline(PIPE_CAP);
+	assert(p);
+	/* the first and last stage share a kthd, the middle one gets its own */
+	assert(lwt_pipeline_stage(p, pipe_add, (void*)1, 2, 1, PIPE_CAP) == 0);
+	assert(lwt_pipeline_stage(p, pipe_add, (void*)2, 3, 2, PIPE_CAP) == 1);
+	assert(lwt_pipeline_stage(p, pipe_add, (void*)3, 1, 1, PIPE_CAP) == 2);
+	assert(!lwt_pipeline_start(p));
+	t = lwt_create(fn_kthd_pipe_feed, p, 0);
+	for (i = 0 ; i < ITER ; i++) {
+		m = lwt_pipeline_rcv(p);
+		assert(m);
+		sum += (int)m;
+	}
+	lwt_join(t);
+	lwt_pipeline_stop(p);
+	assert(!lwt_pipeline_rcv(p));
+	assert(sum == (long long)ITER * (ITER + 1) / 2 + 6LL * ITER);
+	for (i = 0 ; i < 3 ; i++) {
+		assert(!lwt_pipeline_stats(p, i, &stats));
+		assert(stats.num_items == ITER && stats.num_workers == 0);
+	}
+	assert(!lwt_pipeline_free(p));
+}
+
+void *
+fn_kthd_watch(lwt_chan_t to)
+{
+	lwt_cgrp_t g;
+	lwt_chan_t c, tc;
+
+	g = lwt_cgrp();
+	c = lwt_chan(1);
+	assert(!lwt_cgrp_add(g, c));
+	tc = lwt_cgrp_add_timer(g, 10000000000ULL);
+	assert(tc);
+	lwt_snd_chan(to, c);
+	/* ready to wait */
+	lwt_snd(to, (void*)1);
+	/* the reaper sleeps in epoll; the remote send has to get it out through the eventfd */
+	assert(lwt_cgrp_wait(g) == c);
+	assert((int)lwt_rcv(c) == 1);
+	/* cancels the timer */
+	assert(!lwt_cgrp_rem(g, tc));
+	lwt_chan_deref(tc);
+	assert(!lwt_cgrp_rem(g, c));
+	assert(!lwt_cgrp_free(g));
+	lwt_snd(to, (void*)2);
+	lwt_chan_deref(c);
+	lwt_chan_deref(to);
+
+	return NULL;
+}
+
+void
+test_kthd_watch(void)
+{
+	struct lwt_select_case sc;
+	lwt_chan_t from, c;
+
+	printf("[TEST] cross-kthd wakeup of a group waiting on a timer\n");
+	from = lwt_chan(1);
+	assert(!lwt_kthd_create(fn_kthd_watch, from, LWT_NOJOIN));
+	c = lwt_rcv_chan(from);
+	assert((int)lwt_rcv(from) == 1);
+	/* give the other kthd time to go to sleep in epoll */
+	sc.channel = from;
+	sc.op = LWT_SELECT_RCV;
+	assert(lwt_select(&sc, 1, 10000) == -1);
+	lwt_snd(c, (void*)1);
+	assert((int)lwt_rcv(from) == 2);
+	lwt_chan_deref(c);
+	lwt_chan_deref(from);
+}
+
+char *malloc_sent[ITER];
+
+void *
+fn_kthd_malloc(lwt_chan_t to)
+{
+	lwt_chan_t ack;
+	char *held[LWT_SLAB_CHUNK];
+	int i, j, reused = 0;
+
+	ack = lwt_chan(0);
+	lwt_snd_chan(to, ack);
+	for (i = 0 ; i < ITER ; i++) {
+		malloc_sent[i] = lwt_malloc(64);
+		assert(malloc_sent[i]);
+		malloc_sent[i][0] = (char)i;
+		lwt_snd(to, malloc_sent[i]);
+	}
+	lwt_rcv(ack);
+	/* hold a chunk's worth; past what's left of the last chunk, the memory freed on the other kthd comes back */
+	for (i = 0 ; i < LWT_SLAB_CHUNK ; i++) {
+		held[i] = lwt_malloc(64);
+		assert(held[i]);
+		for (j = 0 ; j < ITER && !reused ; j++) reused = held[i] == malloc_sent[j];
+	}
+	assert(reused);
+	for (i = 0 ; i < LWT_SLAB_CHUNK ; i++) lwt_free(held[i]);
+	lwt_chan_deref(ack);
+	lwt_chan_deref(to);
+
+	return NULL;
+}
+
+void
+test_kthd_malloc(void)
+{
+	lwt_chan_t from, ack;
+	char *m;
+	int i;
+
+	printf("[TEST] cross-kthd lwt_free\n");
+	from = lwt_chan(16);
+	assert(!lwt_kthd_create(fn_kthd_malloc, from, LWT_NOJOIN));
+	ack = lwt_rcv_chan(from);
+	for (i = 0 ; i < ITER ; i++) {
+		m = lwt_rcv(from);
+		assert(m[0] == (char)i);
+		lwt_free(m);
+	}
+	lwt_snd(ack, (void*)1);
+	lwt_chan_deref(ack);
+	lwt_chan_deref(from);
+}
+
+#define MPMC_WORKERS 3
+#define MPMC_DONE ((void*)-1)
+
+volatile unsigned int mpmc_sum, mpmc_cnt, mpmc_done;
+
+void *
+fn_kthd_mpmc(lwt_chan_t w)
+{
+	void *d;
+	int cnt = 0, sum = 0;
+
+	while ((d = lwt_rcv(w)) != MPMC_DONE) {
+		sum += (int)d;
+		cnt++;
+	}
+	fetch_and_add(&mpmc_sum, sum);
+	fetch_and_add(&mpmc_cnt, cnt);
+	lwt_chan_deref(w);
+	fetch_and_add(&mpmc_done, 1);
+
+	return NULL;
+}
+
+void
+test_kthd_mpmc(int chsz)
+{
+	lwt_chan_t w;
+	int i;
+
+	printf("[TEST] cross-kthd multi-consumer channel (buffer size %d, %d workers)\n",
+	       chsz, MPMC_WORKERS);
+	mpmc_sum = mpmc_cnt = mpmc_done = 0;
+	w = lwt_chan_mpmc(chsz);
+	assert(w);
+	/* every worker pulls from the same queue on its own kthd */
+	for (i = 0 ; i < MPMC_WORKERS ; i++) {
+		assert(!lwt_kthd_create(fn_kthd_mpmc, w, LWT_NOJOIN));
+	}
+	for (i = 1 ; i <= ITER ; i++) lwt_snd(w, (void*)i);
+	for (i = 0 ; i < MPMC_WORKERS ; i++) lwt_snd(w, MPMC_DONE);
+	while (mpmc_done < MPMC_WORKERS) lwt_yield(LWT_NULL);
+	assert(mpmc_cnt == ITER);
+	assert(mpmc_sum == ITER * (ITER + 1) / 2);
+	/* the workers' references keep the queue alive until they're done */
+	lwt_chan_deref(w);
+}
+
+#define GROW_SNDERS 3
+
+volatile unsigned int grow_id;
+
+void *
+fn_kthd_grow(lwt_chan_t c)
+{
+	int i, id = fetch_and_add(&grow_id, 1);
+
+	/* bursts; the buffer doubles under the senders */
+	for (i = 1 ; i <= ITER ; i++) lwt_snd(c, (void*)((id << 16) | i));
+	lwt_chan_deref(c);
+
+	return NULL;
+}
+
+void
+test_kthd_grow(int chsz, int maxsz)
+{
+	lwt_chan_t c;
+	int i, d, last[GROW_SNDERS];
+
+	printf("[TEST] cross-kthd growable channel (buffer size %d, up to %d, %d senders)\n",
+	       chsz, maxsz, GROW_SNDERS);
+	grow_id = 0;
+	c = lwt_chan_grow(chsz, maxsz);
+	assert(c);
+	for (i = 0 ; i < GROW_SNDERS ; i++) {
+		last[i] = 0;
+		assert(!lwt_kthd_create(fn_kthd_grow, c, LWT_NOJOIN));
+	}
+	/* each sender's data stays in order across the rings */
+	for (i = 0 ; i < ITER * GROW_SNDERS ; i++) {
+		d = (int)lwt_rcv(c);
+		assert((d & 0xffff) == last[d >> 16] + 1);
+		last[d >> 16]++;
+	}
+	assert(lwt_chan_pending(c) == 0);
+	/* the senders' references keep the channel and its rings alive until they're done */
+	lwt_chan_deref(c);
+}
+
+#define BCAST_SUBS 3
+#define BCAST_DONE ((void*)-1)
+
+lwt_bcast_t kthd_bcast;
+
+void *
+fn_kthd_bcast(lwt_chan_t c)
+{
+	lwt_bcast_sub_t s;
+	void *m;
+	int last = 0;
+
+	s = lwt_bcast_sub(kthd_bcast);
+	assert(s);
+	lwt_snd(c, (void*)1);
+	while ((m = lwt_bcast_rcv(s)) != BCAST_DONE) {
+		assert((int)m == last + 1);
+		last = (int)m;
+	}
+	assert(!lwt_bcast_dropped(s));
+	lwt_bcast_unsub(s);
+	lwt_snd(c, (void*)last);
+	lwt_chan_deref(c);
+
+	return NULL;
+}
+
+void
+test_kthd_bcast(int chsz)
+{
+	lwt_chan_t c;
+	int i;
+
+	printf("[TEST] cross-kthd broadcast channel (buffer size %d, %d subscribers)\n",
+	       chsz, BCAST_SUBS);
+	kthd_bcast = lwt_chan_bcast(chsz, BCAST_SUBS, LWT_BCAST_BLOCK);
+	assert(kthd_bcast);
+	c = lwt_chan(BCAST_SUBS);
+	assert(c);
+	/* every subscriber reads the same ring from its own kthd */
+	for (i = 0 ; i < BCAST_SUBS ; i++) {
+		assert(!lwt_kthd_create(fn_kthd_bcast, c, LWT_NOJOIN));
+	}
+	for (i = 0 ; i < BCAST_SUBS ; i++) lwt_rcv(c);
+	for (i = 1 ; i <= ITER ; i++) lwt_bcast_snd(kthd_bcast, (void*)i);
+	lwt_bcast_snd(kthd_bcast, BCAST_DONE);
+	for (i = 0 ; i < BCAST_SUBS ; i++) assert((int)lwt_rcv(c) == ITER);
+	assert(!lwt_bcast_free(kthd_bcast));
+	lwt_chan_deref(c);
+}
+
+void
+test_kthd_grpwait_level(int chsz, int grpsz)
+{
+	lwt_chan_t cs[grpsz], ready[grpsz];
+	int ts[grpsz];
+	int i, j, n;
+	lwt_cgrp_t g;
+
+	printf("[TEST] cross-kthd level-triggered group wait (channel buffer size %d, grpsz %d)\n",
+	       chsz, grpsz);
+	g = lwt_cgrp();
+	assert(g);
+	assert(!lwt_cgrp_trigger(g, LWT_CGRP_LEVEL));
+
+	for (i = 0 ; i < grpsz ; i++) {
+		cs[i] = lwt_chan(chsz);
+		assert(cs[i]);
+		assert(!lwt_kthd_create(fn_grpwait, cs[i], 0));
+		ts[i] = (int)lwt_rcv(cs[i]);
+		lwt_chan_mark_set(cs[i], (void*)(ts[i]));
+		lwt_cgrp_add(g, cs[i]);
+	}
+	/* drain every ready channel before waiting again */
+	for (i = 0 ; i < ITER * grpsz ; ) {
+		n = lwt_cgrp_wait_n(g, ready, grpsz);
+		assert(n > 0 && n <= grpsz);
+		for (j = 0 ; j < n ; j++) {
+			void *r;
+
+			while (!lwt_rcv_try(ready[j], &r)) {
+				assert((int)r == (int)lwt_chan_mark_get(ready[j]));
+				i++;
+			}
+		}
+	}
+	/* the senders' references keep the channels alive until they're done */
+	for (i = 0 ; i < grpsz ; i++) {
+		lwt_cgrp_rem(g, cs[i]);
+		lwt_chan_deref(cs[i]);
+	}
+	assert(!lwt_cgrp_free(g));
+}
+
 void
 test_grpwait(int chsz, int grpsz)
 {
@@ -120,6 +661,23 @@ test_grpwait(int chsz, int grpsz)
 
 int main(){
 	kthd_ping_pong_sync();
+	test_perf_kthd_steam(100, 0);
+	test_perf_kthd_steam(100, 1);
+	test_kthd_bufs();
+	test_kthd_select(0);
+	test_kthd_select(4);
+	test_kthd_mpmc(1);
+	test_kthd_mpmc(16);
+	test_kthd_grow(2, 64);
+	test_kthd_grow(2, 4096);
+	test_kthd_bcast(1);
+	test_kthd_bcast(64);
+	test_kthd_call();
+	test_kthd_pipeline();
+	test_kthd_watch();
+	test_kthd_malloc();
+	test_kthd_grpwait_level(0, 3);
+	test_kthd_grpwait_level(3, 3);
 	test_grpwait(0, 3);
 	//test_grpwait(3, 3);
 	return 0;
@@ -16,9 +16,42 @@
 #include "enums.h"
 
 /**
- * Size of the event buffer
+ * Capacity of the kthd event ring; rounded up to a power of two
  */
-#define EVENT_BUFFER_SIZE 10000
+#ifndef EVENT_BUFFER_SIZE
+#define EVENT_BUFFER_SIZE 1024
+#endif
+
+/**
+ * Size of a cache line
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Number of objects carved out of each chunk a slab cache allocates
+ */
+#ifndef LWT_SLAB_CHUNK
+#define LWT_SLAB_CHUNK 32
+#endif
+
+/**
+ * Number of objects freed on another kthd before they are handed back to the owner at once
+ */
+#ifndef LWT_SLAB_BATCH
+#define LWT_SLAB_BATCH 16
+#endif
+
+/**
+ * Most stages a pipeline can have
+ */
+#ifndef LWT_PIPELINE_MAX_STAGES
+#define LWT_PIPELINE_MAX_STAGES 8
+#endif
+
+/**
+ * Stage placement on the kthd creating the pipeline; other placements each get a kthd of their own
+ */
+#define LWT_STAGE_LOCAL 0
 
 /**
  * Size of the a page in the OS -> 4K
@@ -51,8 +84,47 @@ typedef void *(*lwt_fnt_t)(void *); //function pointer definition
 
 typedef struct lwt* lwt_t;
 
+typedef struct lwt_buf_pool* lwt_buf_pool_t;
+
+typedef struct lwt_buf* lwt_buf_t;
+
+typedef struct lwt_bcast* lwt_bcast_t;
+
+typedef struct lwt_bcast_sub* lwt_bcast_sub_t;
+
+typedef struct lwt_call* lwt_call_t;
+
+typedef struct lwt_pipeline* lwt_pipeline_t;
+typedef void *(*lwt_stage_fn_t)(void *, void *);
+
 
 
+/**
+ * @brief A send or a receive for lwt_select
+ */
+struct lwt_select_case{
+	/**
+	 * The channel to send to or receive from
+	 */
+	lwt_chan_t channel;
+	/**
+	 * Whether the case sends or receives
+	 */
+	lwt_select_op_t op;
+	/**
+	 * The data to send; set to the data received
+	 */
+	void * data;
+	/**
+	 * The lwt parked on the channel; set by lwt_select
+	 */
+	lwt_t selector;
+	/**
+	 * Entry in the channel's list of parked senders
+	 */
+	LIST_ENTRY(lwt_select_case) selectors;
+};
+
 /**
  * @brief Channel group for handling events within a group
  */
@@ -73,6 +145,40 @@ struct lwt_cgrp{
 	 * Creator thread
 	 */
 	lwt_t creator_thread;
+	/**
+	 * When channels are reported as ready
+	 */
+	lwt_cgrp_trigger_t trigger;
+};
+
+/**
+ * @brief Counters of a channel; only kept when built with LWT_CHAN_STATS
+ */
+struct lwt_chan_stats{
+	/**
+	 * Number of items sent
+	 */
+	volatile unsigned int num_snds;
+	/**
+	 * Number of items received
+	 */
+	volatile unsigned int num_rcvs;
+	/**
+	 * Number of sends that blocked
+	 */
+	volatile unsigned int num_snd_blocks;
+	/**
+	 * Microseconds senders spent blocked
+	 */
+	volatile unsigned int blocked_usec;
+	/**
+	 * Most items seen buffered at once; sampled by the receivers
+	 */
+	volatile unsigned long peak_entries;
+	/**
+	 * Number of events raised on the channel's group
+	 */
+	volatile unsigned int num_events;
 };
 
 /**
@@ -80,17 +186,29 @@ struct lwt_cgrp{
  */
 struct lwt_channel{
 	/**
-	 * Definition of the senders head pointer
+	 * The number of senders; counted up front so the count never lags behind the channel being handed out
+	 */
+	volatile int snd_cnt;
+	/**
+	 * The number of references to the channel: one for the receiver and one per sender
 	 */
-	LIST_HEAD(head_senders, lwt) head_senders;
+	volatile int ref_cnt;
 	/**
-	 * The number of senders
+	 * Flag for if a lwt on another kthd was ever handed the channel
 	 */
-	int snd_cnt;
+	volatile int is_shared;
 	/**
 	 * Definition of the blocked senders head pointer
 	 */
 	TAILQ_HEAD(head_blocked_senders, lwt) head_blocked_senders;
+	/**
+	 * Receivers parked on a multi-consumer channel until it has data
+	 */
+	TAILQ_HEAD(head_blocked_receivers, lwt) head_blocked_receivers;
+	/**
+	 * Send cases of lwt_select parked on the channel until it can take data
+	 */
+	LIST_HEAD(head_selectors, lwt_select_case) head_selectors;
 	/**
 	 * The receiving thread
 	 */
@@ -100,25 +218,54 @@ struct lwt_channel{
 	 */
 	void * sync_buffer;
 	/**
-	 * Async Buffer to be passed to the channel
+	 * Data a try-send handed straight to the receiver parked on the channel; a token while it's parked
+	 * with nothing handed over, 0 otherwise
+	 */
+	volatile unsigned long rcv_handoff;
+	/**
+	 * The kind of channel
 	 */
-	void ** async_buffer;
+	lwt_chan_type_t type;
 	/**
-	 * Start index of the buffer
+	 * Ring of pointers for buffered channels; senders on any kthd push into it directly
 	 */
-	unsigned volatile int start_index;
+	struct lwt_ring * async_ring;
 	/**
-	 * End index of the buffer
+	 * Ring of pointers for single sender channels
 	 */
-	unsigned volatile int end_index;
+	struct lwt_spsc_ring * spsc_ring;
 	/**
-	 * Num entries
+	 * Newest ring of a growable channel; senders push into it, or whatever has been linked after it
+	 */
+	struct lwt_ring * volatile push_ring;
+	/**
+	 * Rings a growable channel moved past; freed once no sender on another kthd can still be looking at them
+	 */
+	struct lwt_ring * retired_rings;
+	/**
+	 * Largest ring a growable channel grows to
+	 */
+	unsigned int max_size;
+	/**
+	 * Number of senders on other kthds pushing into a growable channel right now
+	 */
+	volatile unsigned int num_pushers;
+	/**
+	 * Number of pops in a row that left a growable channel's ring mostly empty
+	 */
+	unsigned int low_pops;
+	/**
+	 * Num entries; only used by synchronous channels
 	 */
 	unsigned int num_entries;
 	/**
-	 * Size of the buffer
+	 * Size of the buffer, as rounded up by its ring; 0 for a synchronous channel
 	 */
 	unsigned int buffer_size;
+	/**
+	 * Set while the channel has an event queued on its group
+	 */
+	volatile unsigned long event_queued;
 	/**
 	 * List of receiver channels in a lwt
 	 */
@@ -144,19 +291,232 @@ struct lwt_channel{
 	 * Kthd of the receiver
 	 */
 	lwt_kthd_t kthd;
+	/**
+	 * File descriptor whose readiness is pushed into the channel by the kthd; -1 for other channels
+	 */
+	int watch_fd;
+	/**
+	 * Flag for if the watched descriptor is a timer owned by the channel
+	 */
+	int is_timer;
+#ifdef LWT_CHAN_STATS
+	/**
+	 * Counters of the channel
+	 */
+	struct lwt_chan_stats stats;
+	/**
+	 * Entry in the list of every channel with counters
+	 */
+	LIST_ENTRY(lwt_channel) stats_channels;
+#endif
+};
+
+/**
+ * @brief Slot header of a ring; the element is stored inline right after it
+ */
+struct lwt_ring_slot{
+	/**
+	 * Sequence number of the slot; tells producers and the consumer whose turn it is
+	 */
+	volatile unsigned long sequence;
 };
 
+/**
+ * @brief Bounded multi-producer ring of fixed-size elements stored inline
+ */
+struct lwt_ring{
+	/**
+	 * The slots of the ring
+	 */
+	char * slots;
+	/**
+	 * Number of slots; a power of two
+	 */
+	unsigned int capacity;
+	/**
+	 * Mask for turning a position into a slot index
+	 */
+	unsigned int mask;
+	/**
+	 * Size of an element
+	 */
+	unsigned int elem_size;
+	/**
+	 * Size of a slot including its header
+	 */
+	unsigned int slot_size;
+	/**
+	 * The ring linked after this one by a growable channel; set once
+	 */
+	struct lwt_ring * volatile next;
+	/**
+	 * Next ring on the retired list of a growable channel
+	 */
+	struct lwt_ring * retired;
+	/**
+	 * Position of the tail when the ring was sealed; nothing is pushed at or past it
+	 */
+	volatile unsigned long seal_pos;
+	/**
+	 * Whether the ring is sealed
+	 */
+	volatile int is_sealed;
+	/**
+	 * Next position to push to; shared by the producers
+	 */
+	volatile unsigned long tail __attribute__((aligned(CACHE_LINE_SIZE)));
+	/**
+	 * Next position to pop from; owned by the consumer unless consumers claim it with __ring_pop_mc
+	 */
+	volatile unsigned long head __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+/**
+ * @brief Bounded single-producer single-consumer ring of pointers
+ * Each side keeps a private copy of the other side's index and only rereads the shared one when the
+ * copy says the ring is full (producer) or empty (consumer)
+ */
+struct lwt_spsc_ring{
+	/**
+	 * The slots of the ring
+	 */
+	void ** slots;
+	/**
+	 * Number of slots; a power of two
+	 */
+	unsigned int capacity;
+	/**
+	 * Mask for turning a position into a slot index
+	 */
+	unsigned int mask;
+	/**
+	 * Next position to push to; written by the producer
+	 */
+	volatile unsigned long tail __attribute__((aligned(CACHE_LINE_SIZE)));
+	/**
+	 * The producer's copy of head
+	 */
+	unsigned long cached_head;
+	/**
+	 * Next position to pop from; written by the consumer
+	 */
+	volatile unsigned long head __attribute__((aligned(CACHE_LINE_SIZE)));
+	/**
+	 * The consumer's copy of tail
+	 */
+	unsigned long cached_tail;
+};
+
+/**
+ * @brief Remote operation for a kthd; stored inline in the kthd's event ring
+ */
 struct kthd_event{
+	/**
+	 * The lwt requesting the operation
+	 */
 	lwt_t originator;
+	/**
+	 * The lwt to operate on
+	 */
 	lwt_t lwt;
+	/**
+	 * The channel to operate on
+	 */
 	lwt_chan_t channel;
+	/**
+	 * The group to operate on
+	 */
 	lwt_cgrp_t group;
-	lwt_kthd_t kthd;
-	int is_done;
-	int block;
+	/**
+	 * The select case to operate on
+	 */
+	struct lwt_select_case * select_case;
+	/**
+	 * The buffer pool to operate on
+	 */
+	lwt_buf_pool_t pool;
+	/**
+	 * Completion flag on the originator's stack if it is blocking on the operation; NULL otherwise
+	 */
+	volatile int * is_done;
+	/**
+	 * The operation to perform
+	 */
 	lwt_remote_op_t op;
 };
 
+/**
+ * @brief Header in front of the memory handed out by lwt_malloc
+ */
+struct lwt_malloc_header{
+	/**
+	 * Size class the memory came from; LWT_SLAB_NUM_CACHES if it came from malloc
+	 */
+	unsigned long cache;
+	/**
+	 * Keeps the memory after the header aligned the way malloc's is
+	 */
+	unsigned long pad;
+};
+
+/**
+ * @brief Header kept right after every object of a slab cache
+ */
+struct lwt_slab_obj{
+	/**
+	 * Next object on a free list, remote free stack or batch
+	 */
+	struct lwt_slab_obj * next;
+	/**
+	 * The cache the object was carved for
+	 */
+	struct lwt_slab * slab;
+};
+
+/**
+ * @brief Cache of equally sized objects owned by a kthd
+ */
+struct lwt_slab{
+	/**
+	 * Free objects; only touched by the owning kthd
+	 */
+	struct lwt_slab_obj * free_objs;
+	/**
+	 * Chunks the objects were carved from; linked through their first word
+	 */
+	void * chunks;
+	/**
+	 * The kthd owning the cache
+	 */
+	lwt_kthd_t kthd;
+	/**
+	 * Stack of objects freed on other kthds; whole batches are pushed with CAS, taken whole by the owner
+	 */
+	volatile unsigned long remote_free __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+/**
+ * @brief Objects freed on the current kthd that belong to another kthd's cache
+ */
+struct lwt_slab_batch{
+	/**
+	 * The cache every object of the batch goes back to
+	 */
+	struct lwt_slab * slab;
+	/**
+	 * First object of the batch
+	 */
+	struct lwt_slab_obj * head;
+	/**
+	 * Last object of the batch
+	 */
+	struct lwt_slab_obj * tail;
+	/**
+	 * Number of objects in the batch
+	 */
+	unsigned int count;
+};
+
 struct lwt_kthd{
 	/**
 	 * The Pthread belonging to the kthd
@@ -167,39 +527,275 @@ struct lwt_kthd{
 	 */
 	LIST_HEAD(head_lwts_in_kthd, lwt) head_lwts_in_kthd;
 	/**
-	 * Status flag for if the current remote thread is blocked
+	 * Status flag for if the reaper is asleep; also used as the futex word it sleeps on
+	 */
+	volatile unsigned long is_blocked;
+	/**
+	 * Idle policy of the reaper
+	 */
+	lwt_kthd_idle_t idle_mode;
+	/**
+	 * Number of polls the reaper currently spins for before sleeping
+	 */
+	unsigned int spin_window;
+	/**
+	 * Upper bound for the spin window
+	 */
+	unsigned int spin_max;
+	/**
+	 * Head of the stack of lwts woken by other kthds; pushed to with a CAS and spliced with an exchange
+	 */
+	volatile unsigned long wake_stack;
+	/**
+	 * Number of event batches drained by the reaper
+	 */
+	unsigned int num_batches;
+	/**
+	 * Number of events from the ring processed by the reaper
+	 */
+	unsigned int num_events;
+	/**
+	 * Largest batch of events drained from the ring by the reaper; at most KTHD_EVENT_BATCH
+	 */
+	unsigned int max_batch;
+	/**
+	 * Number of lwts woken off the wake stack
 	 */
-	int is_blocked;
+	unsigned int num_remote_wakeups;
 	/**
-	 * Mutex for the blocked lwt buffer thread
+	 * Number of readinesses of watched descriptors pushed into their channels
 	 */
-	pthread_mutex_t blocked_mutex;
+	unsigned int num_watch_events;
 	/**
-	 * Condition variable for the lwt buffer thread
+	 * Number of duplicate wakeups coalesced by the reaper
 	 */
-	pthread_cond_t blocked_cv;
+	unsigned int num_coalesced;
+	/**
+	 * Number of dispatches since the scheduler last polled for remote events
+	 */
+	unsigned int num_dispatches;
+	/**
+	 * Number of times the scheduler ran the reaper ahead of runnable lwts
+	 */
+	unsigned int num_polls;
+	/**
+	 * Lwt woken by a rendezvous to run as soon as the current one blocks or yields; kept off the run queue
+	 */
+	lwt_t next_thread;
 	/**
 	 * Buffer thread for the lwt
 	 */
 	lwt_t buffer_thread;
 	/**
-	 * Event buffer for remote communication
+	 * Event ring for remote communication
+	 */
+	struct lwt_ring event_ring;
+	/**
+	 * Epoll set of the descriptors watched by channel groups on the kthd; -1 until the first one is added
+	 */
+	int epoll_fd;
+	/**
+	 * Eventfd in the epoll set that other kthds wake the reaper with once it sleeps in epoll
+	 */
+	int wake_fd;
+	/**
+	 * Number of descriptors in the epoll set, not counting the eventfd
 	 */
-	struct kthd_event * event_buffer[EVENT_BUFFER_SIZE];
+	unsigned int num_watches;
 	/**
-	 * Head of the buffer
+	 * Slab caches for the runtime objects created on the kthd
 	 */
-	volatile unsigned int buffer_head;
+	struct lwt_slab slabs[LWT_SLAB_NUM_CACHES];
 	/**
-	 * Tail of the buffer
+	 * Objects of other kthds' caches freed here, waiting to be handed back
 	 */
-	volatile unsigned int buffer_tail;
+	struct lwt_slab_batch slab_batches[LWT_SLAB_NUM_CACHES];
+	/**
+	 * Number of objects taken from the caches minus those freed back on the kthd itself
+	 */
+	unsigned int num_slab_objs;
+	/**
+	 * Objects handed back by other kthds, counted down from 0; num_slab_objs is added when the kthd
+	 * exits, and whoever brings it to 0 afterwards frees the caches and the kthd
+	 */
+	volatile unsigned int slab_debt;
+	/**
+	 * Set once the kthd has exited; events posted afterwards are handled by the poster
+	 */
+	volatile int is_dead;
+	/**
+	 * Number of lwts on other kthds posting an event to the kthd right now
+	 */
+	volatile unsigned int num_posters;
 	/**
 	 * Pointer to the head of the run queue
 	 */
 	TAILQ_HEAD(head_runnable_threads, lwt) head_runnable_threads;
 };
 
+/**
+ * @brief Descriptor of a buffer lent over channels; returned to its pool when the last reference is released
+ */
+struct lwt_buf{
+	/**
+	 * The pool owning the buffer
+	 */
+	lwt_buf_pool_t pool;
+	/**
+	 * The memory of the buffer
+	 */
+	void * data;
+	/**
+	 * Number of bytes the buffer holds
+	 */
+	unsigned int size;
+	/**
+	 * Number of bytes in use; set by whoever fills the buffer
+	 */
+	unsigned int len;
+	/**
+	 * Number of references to the buffer
+	 */
+	volatile int ref_cnt;
+	/**
+	 * Next buffer on the free list or remote free stack of the pool
+	 */
+	struct lwt_buf * next;
+};
+
+/**
+ * @brief Pool of equally sized buffers owned by a kthd
+ */
+struct lwt_buf_pool{
+	/**
+	 * The kthd owning the pool; only it allocates from the pool
+	 */
+	lwt_kthd_t kthd;
+	/**
+	 * Size of each buffer
+	 */
+	unsigned int buf_size;
+	/**
+	 * Number of buffers
+	 */
+	unsigned int num_bufs;
+	/**
+	 * The descriptors of the buffers
+	 */
+	struct lwt_buf * bufs;
+	/**
+	 * Memory backing all of the buffers
+	 */
+	char * memory;
+	/**
+	 * Free buffers; only touched by the owning kthd
+	 */
+	struct lwt_buf * free_bufs;
+	/**
+	 * Lwts parked in lwt_buf_alloc until a buffer is released, linked through their blocked sender
+	 * entries; only touched by the owning kthd
+	 */
+	TAILQ_HEAD(head_blocked_allocs, lwt) head_blocked_allocs;
+	/**
+	 * Stack of buffers released on other kthds; pushed with CAS, taken whole by the owner
+	 */
+	volatile unsigned long remote_free __attribute__((aligned(CACHE_LINE_SIZE)));
+	/**
+	 * Flag for if lwts are parked waiting for a buffer; cleared by the release that wakes them
+	 */
+	volatile unsigned long is_blocked;
+	/**
+	 * Number of releases on other kthds still using the pool; the one waking the parked lwts
+	 * only drops out once the owner has handled its event
+	 */
+	volatile unsigned int num_remote_releasing;
+};
+
+/**
+ * @brief A subscriber of a broadcast channel; each one sits on its own cache line
+ */
+struct lwt_bcast_sub{
+	/**
+	 * The broadcast channel subscribed to
+	 */
+	lwt_bcast_t bcast;
+	/**
+	 * The subscribing lwt; the only one receiving through the subscription
+	 */
+	lwt_t lwt;
+	/**
+	 * Whether the slot is taken by a subscriber; claimed with CAS
+	 */
+	volatile unsigned long is_active;
+	/**
+	 * Sequence number of the next message to receive; only written by the subscriber
+	 */
+	volatile unsigned long cursor;
+	/**
+	 * Whether the subscriber is parked waiting for messages; cleared by whoever wakes it
+	 */
+	volatile unsigned long is_blocked;
+	/**
+	 * Number of messages overwritten before the subscriber got to them
+	 */
+	unsigned int num_dropped;
+}__attribute__((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * @brief Channel with one producer whose messages are received by every subscriber
+ * The producer writes each message once into a shared ring; every subscriber reads it through its own cursor
+ */
+struct lwt_bcast{
+	/**
+	 * The messages; indexed by sequence number
+	 */
+	void * volatile * slots;
+	/**
+	 * Number of slots; a power of two
+	 */
+	unsigned int capacity;
+	/**
+	 * Mask for turning a sequence number into a slot index
+	 */
+	unsigned int mask;
+	/**
+	 * What the producer does when the slowest subscriber is a full ring behind
+	 */
+	lwt_bcast_policy_t policy;
+	/**
+	 * The lwt sending on the channel
+	 */
+	lwt_t producer;
+	/**
+	 * The subscriber slots
+	 */
+	struct lwt_bcast_sub * subs;
+	/**
+	 * Number of subscriber slots
+	 */
+	unsigned int max_subs;
+	/**
+	 * Lower bound of the subscriber cursors; only touched by the producer, rescanned when the ring looks full
+	 */
+	unsigned long min_cursor;
+	/**
+	 * Number of messages published; written by the producer
+	 */
+	volatile unsigned long head __attribute__((aligned(CACHE_LINE_SIZE)));
+	/**
+	 * Number of messages claimed; moved past a slot before the producer overwrites it
+	 */
+	volatile unsigned long tail;
+	/**
+	 * Number of parked subscribers; the producer only scans for them when it isn't 0
+	 */
+	volatile unsigned int num_blocked __attribute__((aligned(CACHE_LINE_SIZE)));
+	/**
+	 * Whether the producer is parked waiting for the slowest subscriber
+	 */
+	volatile unsigned long producer_blocked;
+};
+
 struct lwt_kthd_data{
 	lwt_chan_fn_t channel_fn;
 	lwt_chan_t channel;
@@ -208,6 +804,118 @@ struct lwt_kthd_data{
 	int ready;
 };
 
+/**
+ * @brief A stage of a pipeline; its workers share a bounded input queue
+ */
+struct lwt_stage{
+	/**
+	 * The pipeline the stage belongs to
+	 */
+	lwt_pipeline_t pipeline;
+	/**
+	 * Function applied to each item; returns the item for the next stage, or NULL to drop it
+	 */
+	lwt_stage_fn_t fn;
+	/**
+	 * Argument passed to every call of the function
+	 */
+	void * arg;
+	/**
+	 * Number of workers
+	 */
+	unsigned int parallelism;
+	/**
+	 * Kthd the workers run on; LWT_STAGE_LOCAL, or a number shared by the stages placed together
+	 */
+	unsigned int placement;
+	/**
+	 * Capacity of the input queue
+	 */
+	unsigned int capacity;
+	/**
+	 * Input queue; created on the kthd the stage is placed on
+	 */
+	lwt_chan_t input;
+	/**
+	 * Number of items the workers have processed
+	 */
+	volatile unsigned int num_items;
+	/**
+	 * Number of workers that haven't stopped yet
+	 */
+	volatile unsigned int num_running;
+};
+
+/**
+ * @brief Chain of stages connected by bounded queues; a full queue blocks the stage feeding it
+ */
+struct lwt_pipeline{
+	/**
+	 * The stages, from first to last
+	 */
+	struct lwt_stage stages[LWT_PIPELINE_MAX_STAGES];
+	/**
+	 * Number of stages
+	 */
+	unsigned int num_stages;
+	/**
+	 * Queue receiving what the last stage returns; NULL if it is dropped
+	 */
+	lwt_chan_t output;
+	/**
+	 * The lwt that created the pipeline; it feeds and drains it
+	 */
+	lwt_t creator;
+	/**
+	 * Flag for if the workers have been started
+	 */
+	int is_started;
+	/**
+	 * Flag for if the output queue has been drained up to the stop
+	 */
+	int is_drained;
+};
+
+/**
+ * @brief Counters of a pipeline stage
+ */
+struct lwt_stage_stats{
+	/**
+	 * Items waiting in the input queue
+	 */
+	unsigned int depth;
+	/**
+	 * Items processed so far
+	 */
+	unsigned int num_items;
+	/**
+	 * Workers still running
+	 */
+	unsigned int num_workers;
+};
+
+/**
+ * @brief Reply slot of a call; embedded in the calling lwt, which stays parked until the reply
+ */
+struct lwt_call{
+	/**
+	 * The calling lwt
+	 */
+	lwt_t caller;
+	/**
+	 * The request sent with the call
+	 */
+	void * request;
+	/**
+	 * The reply; only read once is_replied is set
+	 */
+	void * volatile reply;
+	/**
+	 * Flag for if the server has replied
+	 */
+	volatile int is_replied;
+};
+
 
 
 /**
@@ -260,23 +968,36 @@ struct lwt
 	 */
 	LIST_ENTRY(lwt) ready_pool_threads;
 
-	/**
-	 * List of senders
-	 */
-	LIST_ENTRY(lwt) senders;
 	/**
 	 * List of blocked senders
 	 */
 	TAILQ_ENTRY(lwt) blocked_senders;
+	/**
+	 * Flag for if the lwt is on a channel's blocked senders queue
+	 */
+	volatile int is_blocked_sender;
+	/**
+	 * List of receivers parked on a multi-consumer channel
+	 */
+	TAILQ_ENTRY(lwt) blocked_receivers;
+	/**
+	 * Flag for if the lwt is on a channel's blocked receivers queue
+	 */
+	volatile int is_blocked_receiver;
 	/**
 	 * Head of the receiver channels associated with the lwt
 	 */
 	LIST_HEAD(head_receiver_channel, lwt_channel) head_receiver_channel;
 
 	/**
-	 * Sync buffer
+	 * Sync buffer; cleared by the receiver once it has taken the data
 	 */
-	void * sync_buffer;
+	void * volatile sync_buffer;
+
+	/**
+	 * Reply slot for the lwt's outstanding call
+	 */
+	struct lwt_call call;
 
 	/**
 	 * The start routine for the thread to run
@@ -310,6 +1031,15 @@ struct lwt
 	 * Pointer to kthd
 	 */
 	lwt_kthd_t kthd;
+
+	/**
+	 * Next lwt on the wake stack of the kthd
+	 */
+	struct lwt * wake_next;
+	/**
+	 * Flag for if the lwt is already on the wake stack of the kthd
+	 */
+	volatile unsigned long wake_queued;
 };
 
 